@@ -0,0 +1,59 @@
+#include <coalesced_hardware_file.h>
+#include <hardware_outfile.h>
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	using namespace reven;
+	vmghost::coalesced_hardware_file file;
+	std::uint32_t version = 0;
+
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+		std::string option = argv[arg];
+		if (arg + 1 >= argc)
+			break;
+
+		if (option == "-t") {
+			file.set_tsc_tolerance(std::stoull(argv[arg + 1]));
+		} else if (option == "-s") {
+			file.set_max_size(std::stoull(argv[arg + 1]));
+		} else if (option == "-f") {
+			version = std::stoul(argv[arg + 1]);
+		} else {
+			break;
+		}
+	}
+
+	if (argc - arg != 2) {
+		std::cerr << "Usage: " << std::endl << argv[0] << " [-t tsc_tolerance] [-s max_size] [-f format_version]"
+		          << " source dest" << std::endl;
+		return 1;
+	}
+
+	if (not file.load(argv[arg])) {
+		std::cerr << "Could not load " << argv[arg] << std::endl;
+		return 1;
+	}
+
+	vmghost::hardware_outfile out;
+	if (not out.open(argv[arg + 1], version)) {
+		std::cerr << "Could not create " << argv[arg + 1] << std::endl;
+		return 1;
+	}
+
+	while (file.next().valid()) {
+		out.write(file.current());
+	}
+
+	if (not out.close()) {
+		std::cerr << "Could not write " << argv[arg + 1] << std::endl;
+		return 1;
+	}
+
+	std::cout << std::dec << file.source_position() << " accesses coalesced into " << file.position() << std::endl;
+
+	return 0;
+}
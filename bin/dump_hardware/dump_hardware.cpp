@@ -1,4 +1,5 @@
 #include <hardware_file.h>
+#include <hardware_index.h>
 
 #include <iostream>
 
@@ -30,10 +31,17 @@ int main(int argc, char** argv)
 		}
 		std::uint64_t num = std::stoul(arg);
 
-		while (file.next().valid() && num > 0)
-			--num;
+		// Displays the access that follows the num-th one.
+		hardware_index index;
+		if (index.load_or_build(argv[1])) {
+			index.seek(file, num + 1);
+		} else {
+			while (file.next().valid() && num > 0)
+				--num;
+			file.next();
+		}
 
-		if (file.next().valid()) {
+		if (file.current().valid()) {
 			if (binary_display) {
 				std::cout.write(reinterpret_cast<const char*>(file.current().data.data()), file.current().data.size());
 				std::cout << std::flush;
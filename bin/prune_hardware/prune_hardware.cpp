@@ -0,0 +1,47 @@
+#include <hardware_pruner.h>
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	using namespace reven;
+	vmghost::hardware_pruner pruner;
+
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+		std::string option = argv[arg];
+		if (arg + 1 >= argc)
+			break;
+
+		if (option == "-m") {
+			pruner.set_memory_budget(std::stoull(argv[arg + 1]) << 20);
+		} else if (option == "-f") {
+			pruner.set_output_version(std::stoul(argv[arg + 1]));
+		} else {
+			break;
+		}
+	}
+
+	if (argc - arg != 3) {
+		std::cerr << "Usage: " << std::endl << argv[0] << " [-m memory_budget_in_MiB] [-f format_version]"
+		          << " hardware_file sync_file dest" << std::endl;
+		return 1;
+	}
+
+	vmghost::sync_file sync;
+	if (not sync.load(argv[arg + 1], "")) {
+		std::cerr << "Could not load " << argv[arg + 1] << std::endl;
+		return 1;
+	}
+
+	if (not pruner.prune(argv[arg], sync, argv[arg + 2])) {
+		std::cerr << "Could not prune " << argv[arg] << " into " << argv[arg + 2] << std::endl;
+		return 1;
+	}
+
+	std::cout << std::dec << "Pruned " << pruner.pruned_accesses() << " of " << pruner.accesses() << " accesses, "
+	          << pruner.pruned_bytes() << " of " << pruner.bytes() << " bytes" << std::endl;
+
+	return 0;
+}
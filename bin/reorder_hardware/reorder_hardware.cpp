@@ -1,43 +1,49 @@
-#include <hardware_file.h>
-#include <streamable_outfile.h>
+#include <hardware_sort.h>
 
 #include <iostream>
-#include <map>
-#include <cassert>
+#include <string>
 
 int main(int argc, char** argv)
 {
 	using namespace reven;
-	vmghost::hardware_file file;
-	vmghost::streamable_outfile out;
+	vmghost::hardware_sorter sorter;
+
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+		std::string option = argv[arg];
+		if (arg + 1 >= argc)
+			break;
+
+		if (option == "-m") {
+			sorter.set_memory_budget(std::stoull(argv[arg + 1]) << 20);
+		} else if (option == "-j") {
+			sorter.set_threads(std::stoul(argv[arg + 1]));
+		} else if (option == "-w") {
+			sorter.set_window(std::stoull(argv[arg + 1]));
+		} else if (option == "-f") {
+			sorter.set_output_version(std::stoul(argv[arg + 1]));
+		} else if (option == "-c") {
+			sorter.set_payload_compression(std::stoul(argv[arg + 1]) != 0);
+		} else {
+			break;
+		}
+	}
 
-	if (argc != 3) {
-		std::cerr << "Usage: " << std::endl << argv[0] << " source dest" << std::endl;
+	if (argc - arg != 2) {
+		std::cerr << "Usage: " << std::endl << argv[0] << " [-m memory_budget_in_MiB] [-j threads] [-w window] [-f format_version]"
+		          << " [-c compress_payloads] source dest"
+		          << std::endl;
 		return 1;
 	}
 
-	file.load(argv[1]);
-	out.open(argv[2]);
-
-	std::uint64_t magic = HARDWARE_FILE_MAGIC;
-	std::uint32_t version = 0;
-	out << magic << version;
-
-	std::multimap<std::uint64_t, vmghost::hardware_access> accesses;
-
-	while (file.next().valid()) {
-		accesses.insert(std::make_pair(file.current().tsc, file.current()));
+	if (not sorter.sort(argv[arg], argv[arg + 1])) {
+		std::cerr << "Could not reorder " << argv[arg] << " into " << argv[arg + 1] << std::endl;
+		return 1;
 	}
 
-	std::uint64_t __attribute__((unused)) current_tsc = 0;
-	for (auto& pair : accesses) {
-		auto& access = pair.second;
-		assert(current_tsc <= access.tsc);
-
-		out << access.tsc << access.physical_address << access.type << access.device_id << access.device_instance
-		    << access.data;
-
-		current_tsc = access.tsc;
+	if (sorter.fell_back()) {
+		std::cerr << "Accesses are out of order by more than the window, a full sort was needed" << std::endl;
 	}
+
 	return 0;
 }
@@ -0,0 +1,36 @@
+#include <hardware_demux.h>
+
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+	using namespace reven::vmghost;
+
+	if (argc != 3 && argc != 4) {
+		std::cerr << "Usage: " << std::endl << argv[0] << " source dest_prefix [io_file]" << std::endl;
+		return 1;
+	}
+
+	io_file io;
+	if (argc == 4 && not io.load(argv[3])) {
+		std::cerr << "Could not load " << argv[3] << std::endl;
+		return 1;
+	}
+
+	hardware_manifest manifest;
+	if (not split_hardware_file(argv[1], argv[2], argc == 4 ? &io : nullptr, manifest)) {
+		std::cerr << "Could not split " << argv[1] << std::endl;
+		return 1;
+	}
+
+	for (const hardware_stream& stream : manifest.streams()) {
+		std::cout << std::dec << stream.file_name << ": device " << stream.device_id << " instance "
+		          << stream.device_instance;
+		if (not stream.device_name.empty())
+			std::cout << " (" << stream.device_name << ")";
+		std::cout << ", " << stream.count << " accesses, TSC " << std::hex << std::showbase << stream.first_tsc << "-"
+		          << stream.last_tsc << std::noshowbase << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "shared_blob.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Keeps a single copy of identical blobs.
+//!
+//! Blobs are found by a hash of their content, and compared before being shared, so that a hash collision never
+//! merges different blobs. The pool does not keep its blobs alive: a buffer is freed when its last blob is destroyed,
+//! and the pool forgets it.
+//!
+//! A pool can be shared by several sync files, and used from several threads.
+class blob_pool {
+public:
+	blob_pool();
+
+	//! Returns a blob with the specified content, sharing the buffer of an identical live blob if there is one.
+	shared_blob intern(std::vector<std::uint8_t>&& bytes);
+
+	//! Size of all the blobs interned, and of the buffers allocated for them.
+	std::uint64_t interned_bytes() const;
+	std::uint64_t stored_bytes() const;
+
+	//! Number of blobs interned, and of buffers allocated for them.
+	std::uint64_t interned_blobs() const;
+	std::uint64_t stored_blobs() const;
+
+	//! interned_bytes / stored_bytes, 1 when nothing was interned.
+	double deduplication_ratio() const;
+
+	//! Size and number of the buffers currently alive.
+	std::uint64_t live_bytes() const;
+	std::uint64_t live_blobs() const;
+
+private:
+	using buffer = std::vector<std::uint8_t>;
+
+	//! Forgets the buffers that were freed.
+	void purge();
+
+	mutable std::mutex mutex_;
+
+	//! Buffers by hash of their content.
+	std::unordered_multimap<std::uint64_t, std::weak_ptr<const buffer>> buffers_;
+
+	//! Size of buffers_ after the last purge.
+	std::size_t purged_size_;
+
+	std::uint64_t interned_bytes_;
+	std::uint64_t stored_bytes_;
+	std::uint64_t interned_blobs_;
+	std::uint64_t stored_blobs_;
+}; // class blob_pool
+}
+} // namespace reven::vmghost
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "hardware_file.h"
+
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Reads a hardware file, merging bursts of small writes into larger ones.
+//!
+//! Consecutive accesses are merged when they are writes into main memory of the same type, from the same device
+//! instance, whose physical ranges are contiguous or overlap, and whose TSCs are at most tsc_tolerance apart. Where
+//! they overlap, the data of the later access wins, as it would when replaying them one after the other. The merged
+//! access has the TSC of the last access merged into it.
+//!
+//! Only accesses that follow each other in the file are merged, so that no access is moved across another one. MMIO
+//! and port accesses are never merged.
+class coalesced_hardware_file {
+public:
+	coalesced_hardware_file();
+
+	//! Maximum TSC difference between two accesses merged together. Defaults to 0: same TSC only.
+	void set_tsc_tolerance(std::uint64_t tsc_tolerance) { tsc_tolerance_ = tsc_tolerance; }
+	std::uint64_t tsc_tolerance() const { return tsc_tolerance_; }
+
+	//! Maximum size of a merged access. Larger accesses are left as-is. Defaults to 64 KiB.
+	void set_max_size(std::uint64_t max_size) { max_size_ = max_size; }
+	std::uint64_t max_size() const { return max_size_; }
+
+	bool load(const std::string& file_name);
+
+	const hardware_access& current() const { return current_; }
+
+	const hardware_access& next();
+
+	//! Number of accesses returned so far.
+	std::uint64_t position() const { return position_; }
+
+	//! Number of accesses read from the file so far, including the one that may be waiting to be returned.
+	std::uint64_t source_position() const { return source_position_; }
+
+private:
+	//! True if access can be merged into the access being built.
+	bool can_merge(const hardware_access& access) const;
+
+	//! Merges access into the access being built.
+	void merge(const hardware_access& access);
+
+	hardware_file file_;
+
+	std::uint64_t tsc_tolerance_;
+	std::uint64_t max_size_;
+
+	hardware_access current_;
+
+	//! The access read from the file that could not be merged, returned next.
+	hardware_access lookahead_;
+	bool has_lookahead_;
+
+	//! Data and range of the access being built.
+	std::vector<std::uint8_t> data_;
+	std::uint64_t begin_;
+
+	std::uint64_t position_;
+	std::uint64_t source_position_;
+}; // class coalesced_hardware_file
+}
+} // namespace reven::vmghost
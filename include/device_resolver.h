@@ -0,0 +1,63 @@
+#pragma once
+
+#include "device.h"
+#include "hardware_access.h"
+#include "hardware_batch.h"
+
+#include <map>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! The device, and the instance of the device, mapped at some port or physical address.
+struct device_match {
+	//! nullptr if no device is mapped there.
+	const device* dev = nullptr;
+	std::uint32_t instance = 0;
+
+	explicit operator bool() const { return dev != nullptr; }
+};
+
+//! Finds the device mapped at a port or at a physical address.
+//!
+//! Ports are resolved with a flat table covering all 64K ports, and physical addresses with a binary search in the
+//! sorted memory ranges. If ranges overlap, the one that starts first wins.
+//!
+//! The resolver points to the devices it was built from, they must outlive it.
+class device_resolver {
+public:
+	device_resolver();
+
+	void build(const std::map<std::uint64_t, device>& devices);
+
+	//! Device mapped at the specified port.
+	device_match resolve_port(std::uint16_t port) const { return targets_[ports_[port]]; }
+
+	//! Device mapped at the specified physical address.
+	device_match resolve_address(std::uint64_t physical_address) const;
+
+	//! Device targeted by the specified access: port accesses are resolved by port, the others by address.
+	device_match resolve(const hardware_access_header& access) const
+	{
+		return access.is_port() ? resolve_port(static_cast<std::uint16_t>(access.physical_address))
+		                        : resolve_address(access.physical_address);
+	}
+
+	//! Resolves all the accesses of the batch, in order.
+	void resolve(const hardware_batch& batch, std::vector<device_match>& matches) const;
+
+private:
+	//! All the (device, instance) pairs. The first one is the absence of device.
+	std::vector<device_match> targets_;
+
+	//! Index in targets_ for each port.
+	std::vector<std::uint32_t> ports_;
+
+	//! Non-overlapping memory ranges, sorted by start address.
+	std::vector<std::uint64_t> range_starts_;
+	std::vector<std::uint64_t> range_ends_;
+	std::vector<std::uint32_t> range_targets_;
+}; // class device_resolver
+}
+} // namespace reven::vmghost
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "sync_event.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Compact in-memory table of sync events.
+//!
+//! Each event is stored as a few bytes: its flags, start reason and interrupt, and its contexts as the mask of the
+//! registers that changed (see sync_event::context::differing_registers) followed by the changed values only. The
+//! start context is encoded against the new context of the previous event, and the new context against the start
+//! context. Values are stored as variable length differences with their reference, and memory dumps share their
+//! buffers with the events they come from.
+//!
+//! Every keyframe_interval events, a keyframe is encoded against nothing, so that an event is decoded from the
+//! keyframe before it at most. Reading the events in order through a reader decodes each of them once.
+//!
+//! Events convert back to exactly the sync_event they were built from.
+class event_table {
+public:
+	//! Reads the events of a table, decoding each of them from the previous one when read in order.
+	class reader {
+	public:
+		explicit reader(const event_table& table);
+
+		//! Event at the specified index, valid until the next call. Throws std::out_of_range if there is no such event.
+		const sync_event& get(std::uint64_t index);
+
+	private:
+		const event_table* table_;
+
+		//! Index, offset in the table and first dump of the next event to decode.
+		std::uint64_t next_index_;
+		std::uint64_t next_offset_;
+		std::uint64_t next_dump_;
+
+		sync_event event_;
+	};
+
+	//! Defaults to a keyframe every 64 events.
+	explicit event_table(std::uint64_t keyframe_interval = 64);
+
+	std::uint64_t keyframe_interval() const { return keyframe_interval_; }
+
+	void push_back(const sync_event& event);
+
+	std::uint64_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	//! Decodes the event at the specified index from the keyframe before it. Prefer a reader for sequential reads.
+	//! Throws std::out_of_range if there is no such event.
+	sync_event at(std::uint64_t index) const;
+
+	//! Approximate memory used by the table, in bytes, not counting the buffers of the dumps.
+	std::uint64_t memory_usage() const;
+
+	void clear();
+
+private:
+	struct keyframe {
+		std::uint64_t offset;
+		std::uint64_t first_dump;
+	};
+
+	//! Decodes the event at offset into event, which holds the previous event unless this is a keyframe.
+	//! Returns the offset of the next event, and moves dump past the dumps of the event.
+	std::uint64_t decode(std::uint64_t offset, std::uint64_t& dump, bool is_keyframe, sync_event& event) const;
+
+	std::uint64_t keyframe_interval_;
+
+	std::vector<std::uint8_t> bytes_;
+	std::vector<keyframe> keyframes_;
+	std::vector<sync_point_data> dumps_;
+	std::uint64_t size_;
+
+	//! Last event pushed, the reference of the next one.
+	sync_event last_;
+}; // class event_table
+}
+} // namespace reven::vmghost
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace reven {
+namespace vmghost {
+
+//! Identifies a version of a file by its size and modification time.
+//!
+//! Used to check that a file derived from another one, such as an index, is still up to date.
+struct file_stamp {
+	std::uint64_t size = 0;
+
+	//! Modification time, in nanoseconds since the epoch.
+	std::uint64_t modification_time = 0;
+
+	//! Retrieves the stamp of the specified file. Returns false if the file does not exist.
+	static bool of(const std::string& file_name, file_stamp& stamp);
+};
+
+inline bool operator==(const file_stamp& lhs, const file_stamp& rhs)
+{
+	return lhs.size == rhs.size && lhs.modification_time == rhs.modification_time;
+}
+
+inline bool operator!=(const file_stamp& lhs, const file_stamp& rhs)
+{
+	return !(lhs == rhs);
+}
+}
+} // namespace reven::vmghost
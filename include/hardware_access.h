@@ -1,15 +1,16 @@
 #pragma once
 
 #include "streamable_file.h"
+#include "streamable_outfile.h"
+#include "hardware_payload.h"
 
 namespace reven {
 namespace vmghost {
 
-//! Represents an atomic hardware access to the main memory.
+//! Fixed size part of a hardware access, i.e. everything but its data.
 //!
-//! The hardware accesses are recorded as is during the scenario, to be replayed when the conditions of the scenario
-//! match with the emulated conditions.
-struct hardware_access {
+//! Allows to look at an access, or to store it densely, without touching its payload.
+struct hardware_access_header {
 	enum hardware_access_type {
 		write = 0x000000001,
 		pci = 0x000000002,
@@ -37,14 +38,6 @@ struct hardware_access {
 	//! Instance of the device when several instances of the same device exist.
 	std::uint32_t device_instance;
 
-	//! Data concerned by the read or write.
-	//! If this is a write, this is the content that the hardware set into memory.
-	//! If this is a read, this is the content that the hardware received in the recorded scenario.
-	std::vector<std::uint8_t> data;
-
-	//! Number of bytes read or written by the hardware.
-	std::uint64_t length() const { return data.size(); }
-
 	//! Returns true if the specified flag is set in the type variable.
 	bool has_type(hardware_access_type checked_type) const { return (type & checked_type) == checked_type; }
 
@@ -67,6 +60,23 @@ struct hardware_access {
 	//! True if the hardware is writing into main memory.
 	bool is_write() const { return has_type(hardware_access_type::write); }
 
+	bool valid() const { return tsc != 0; }
+};
+
+//! Represents an atomic hardware access to the main memory.
+//!
+//! The hardware accesses are recorded as is during the scenario, to be replayed when the conditions of the scenario
+//! match with the emulated conditions.
+struct hardware_access : hardware_access_header {
+	//! Data concerned by the read or write.
+	//! If this is a write, this is the content that the hardware set into memory.
+	//! If this is a read, this is the content that the hardware received in the recorded scenario.
+	//! Small payloads are stored inline, see hardware_payload.
+	hardware_payload data;
+
+	//! Number of bytes read or written by the hardware.
+	std::uint64_t length() const { return data.size(); }
+
 	//! Convert the first high order bytes of the data into a number.
 	//!
 	//! This is mostly useful to be able to retrieve small data elements.
@@ -78,17 +88,63 @@ struct hardware_access {
 
 		return result;
 	}
+};
 
-	bool valid() const { return tsc != 0; }
+//! A hardware access whose data is not owned, but points into a buffer, typically a mapped hardware file.
+//!
+//! The data pointer is only valid as long as the underlying buffer is.
+struct hardware_access_view : hardware_access_header {
+	const std::uint8_t* data = nullptr;
+
+	//! Number of bytes read or written by the hardware.
+	std::uint64_t length = 0;
+
+	//! Same as hardware_access::to_uint64.
+	std::uint64_t to_uint64() const
+	{
+		std::uint64_t result = 0;
+
+		::memcpy(&result, data, std::min(length, sizeof(std::uint64_t)));
+
+		return result;
+	}
+
+	//! Copies the access and its data.
+	hardware_access to_access() const
+	{
+		hardware_access result;
+
+		static_cast<hardware_access_header&>(result) = *this;
+		result.data.assign(data, data + length);
+
+		return result;
+	}
 };
 
 std::ostream& operator<<(std::ostream& out, const hardware_access& access);
 
+inline streamable_file& operator>>(streamable_file& in, hardware_access_header& header)
+{
+	in >> header.tsc >> header.physical_address >> header.type >> header.device_id >> header.device_instance;
+	return in;
+}
+
 inline streamable_file& operator>>(streamable_file& in, hardware_access& access)
 {
-	in >> access.tsc >> access.physical_address >> access.type >> access.device_id >> access.device_instance >>
-	    access.data;
+	in >> static_cast<hardware_access_header&>(access) >> access.data;
 	return in;
 }
+
+inline streamable_outfile& operator<<(streamable_outfile& out, const hardware_access_header& header)
+{
+	out << header.tsc << header.physical_address << header.type << header.device_id << header.device_instance;
+	return out;
+}
+
+inline streamable_outfile& operator<<(streamable_outfile& out, const hardware_access& access)
+{
+	out << static_cast<const hardware_access_header&>(access) << access.data;
+	return out;
+}
 }
 } // namespace reven::vmghost
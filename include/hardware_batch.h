@@ -0,0 +1,56 @@
+#pragma once
+
+#include "hardware_access.h"
+
+namespace reven {
+namespace vmghost {
+
+//! A batch of hardware accesses decoded in one go by hardware_file::read_batch or hardware_file::read_until_tsc.
+//!
+//! The fixed part of the accesses is stored in a dense array, and their payloads are packed contiguously in a single
+//! buffer. Reading into a batch appends to it: the entries stay valid until the batch is recycled, which clears it
+//! while keeping the allocated memory for the next reads. Pointers returned by data() are only valid until the next
+//! read into the batch though, as the payload buffer may have to grow.
+class hardware_batch {
+public:
+	struct entry : hardware_access_header {
+		//! Position of the access record in the hardware file.
+		std::uint64_t file_position;
+
+		//! Location of the data of this access in the payload buffer of the batch.
+		std::uint64_t data_offset;
+
+		//! Number of bytes read or written by the hardware.
+		std::uint64_t length;
+	};
+
+	std::size_t size() const { return entries_.size(); }
+	bool empty() const { return entries_.empty(); }
+
+	const entry& operator[](std::size_t index) const { return entries_[index]; }
+	const std::vector<entry>& entries() const { return entries_; }
+
+	//! Data of the specified access.
+	const std::uint8_t* data(std::size_t index) const { return payload_.data() + entries_[index].data_offset; }
+
+	//! Total size of the payloads stored in the batch.
+	std::size_t payload_size() const { return payload_.size(); }
+
+	//! Copies the specified access out of the batch.
+	hardware_access access(std::size_t index) const;
+
+	//! Forgets all the accesses of the batch, but keeps the allocated memory.
+	void recycle()
+	{
+		entries_.clear();
+		payload_.clear();
+	}
+
+private:
+	friend class hardware_file;
+
+	std::vector<entry> entries_;
+	std::vector<std::uint8_t> payload_;
+}; // class hardware_batch
+}
+} // namespace reven::vmghost
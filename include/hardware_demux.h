@@ -0,0 +1,74 @@
+#pragma once
+
+#include "file_stamp.h"
+#include "io_file.h"
+
+#include <string>
+#include <vector>
+
+#define HARDWARE_MANIFEST_MAGIC 0x6d636e79734e5652
+#define HARDWARE_MANIFEST_VERSION 0
+
+namespace reven {
+namespace vmghost {
+
+//! The accesses of a single device instance, split out of a hardware file.
+struct hardware_stream {
+	std::uint64_t device_id;
+	std::uint32_t device_instance;
+
+	//! Name of the device in the io file, empty if unknown.
+	std::string device_name;
+
+	//! Hardware file containing the accesses of the device instance.
+	std::string file_name;
+
+	//! Number of accesses in the stream.
+	std::uint64_t count;
+
+	std::uint64_t first_tsc;
+	std::uint64_t last_tsc;
+};
+
+//! Describes how a hardware file was split into one hardware file per device instance.
+class hardware_manifest {
+public:
+	//! Name of the manifest of the streams created with the specified prefix.
+	static std::string manifest_file_name(const std::string& prefix);
+
+	//! Loads the specified manifest. Returns false if it cannot be read.
+	bool load(const std::string& file_name);
+
+	//! Returns false if the manifest cannot be written.
+	bool save(const std::string& file_name) const;
+
+	//! The hardware file that was split.
+	const std::string& source() const { return source_; }
+
+	//! Returns false if the hardware file changed since it was split.
+	bool is_up_to_date() const;
+
+	const std::vector<hardware_stream>& streams() const { return streams_; }
+
+	//! Returns the stream of the specified device instance, or nullptr if the device had no access.
+	const hardware_stream* find(std::uint64_t device_id, std::uint32_t device_instance) const;
+
+private:
+	friend bool split_hardware_file(const std::string& source, const std::string& prefix, const io_file* io,
+	                                hardware_manifest& manifest);
+
+	std::string source_;
+	file_stamp source_stamp_;
+
+	std::vector<hardware_stream> streams_;
+}; // class hardware_manifest
+
+//! Splits the source hardware file into one hardware file per device instance, in a single pass.
+//!
+//! The streams are named "<prefix>.<device id>-<instance>" and keep the order the accesses had in the source: if it
+//! was sorted, so are they. The devices are named after the io file, if specified.
+//! The manifest is filled and saved as "<prefix>.manifest". Returns false if a file cannot be read or written.
+bool split_hardware_file(const std::string& source, const std::string& prefix, const io_file* io,
+                         hardware_manifest& manifest);
+}
+} // namespace reven::vmghost
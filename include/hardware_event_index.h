@@ -0,0 +1,94 @@
+#pragma once
+
+#include "file_stamp.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define HARDWARE_EVENT_INDEX_MAGIC 0x6a636e79734e5652
+#define HARDWARE_EVENT_INDEX_VERSION 0
+
+namespace reven {
+namespace vmghost {
+
+//! Joins the accesses of a hardware file with the events of a sync file, by TSC.
+//!
+//! For each access, the index knows the nearest events before and after it, and for each event, the accesses between
+//! it and the next event. Events and accesses are ordered as in a timeline: an access at the TSC of an event comes
+//! after it. Events are numbered from 0 in the order of the sync file, and accesses by their ordinal in the hardware
+//! file, which must be sorted by TSC (see reorder_hardware).
+//!
+//! The index is built in a single pass over both files, and stored next to the hardware file. It is only used if
+//! neither file changed since.
+class hardware_event_index {
+public:
+	//! Returned when there is no event before or after an access.
+	static constexpr std::uint64_t no_event = UINT64_MAX;
+
+	//! Name of the event index file of the specified hardware file.
+	static std::string index_file_name(const std::string& hardware_file_name);
+
+	//! Indexes the specified files. Returns false if a file cannot be read, and throws if the hardware file is not
+	//! sorted.
+	bool build(const std::string& hardware_file_name, const std::string& sync_file_name);
+
+	//! Loads the index of the specified files. Returns false if there is no index, if it is out of date,
+	//! or if the file is not an index.
+	bool load(const std::string& hardware_file_name, const std::string& sync_file_name);
+
+	//! Writes the index next to the hardware file it was built from. Returns false on error.
+	bool save() const;
+
+	//! Loads the index of the specified files, building and saving it if necessary.
+	bool load_or_build(const std::string& hardware_file_name, const std::string& sync_file_name);
+
+	std::uint64_t access_count() const { return access_events_.size(); }
+	std::uint64_t event_count() const { return event_positions_.size(); }
+
+	//! Last event at or before the specified access, or no_event.
+	std::uint64_t preceding_event(std::uint64_t ordinal) const
+	{
+		return access_events_[ordinal] == 0 ? no_event : access_events_[ordinal] - 1;
+	}
+
+	//! First event after the specified access, or no_event.
+	std::uint64_t following_event(std::uint64_t ordinal) const
+	{
+		return access_events_[ordinal] == event_count() ? no_event : access_events_[ordinal];
+	}
+
+	//! Ordinals [first, last) of the accesses between the specified event and the next one.
+	std::pair<std::uint64_t, std::uint64_t> event_accesses(std::uint64_t event) const
+	{
+		return {event_first_accesses_[event + 1], event_first_accesses_[event + 2]};
+	}
+
+	//! Ordinals [first, last) of the accesses before the first event.
+	std::pair<std::uint64_t, std::uint64_t> leading_accesses() const { return {0, event_first_accesses_[1]}; }
+
+	//! Position of the specified event in the sync file, see sync_file::advance_to.
+	std::uint64_t event_position(std::uint64_t event) const { return event_positions_[event]; }
+
+	//! TSC of the specified event, see timeline::event_tsc.
+	std::uint64_t event_tsc(std::uint64_t event) const { return event_tscs_[event]; }
+
+private:
+	std::string hardware_file_name_;
+	file_stamp hardware_stamp_;
+	std::string sync_file_name_;
+	file_stamp sync_stamp_;
+
+	//! Number of events before each access.
+	std::vector<std::uint64_t> access_events_;
+
+	//! Number of accesses before each event, preceded by 0 and followed by the number of accesses, so that the
+	//! accesses after event e are [event_first_accesses_[e + 1], event_first_accesses_[e + 2]).
+	std::vector<std::uint64_t> event_first_accesses_;
+
+	std::vector<std::uint64_t> event_positions_;
+	std::vector<std::uint64_t> event_tscs_;
+}; // class hardware_event_index
+}
+} // namespace reven::vmghost
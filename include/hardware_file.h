@@ -2,35 +2,140 @@
 
 #include "streamable_file.h"
 #include "hardware_access.h"
+#include "hardware_batch.h"
+#include "hardware_filter.h"
+#include "payload_store.h"
+
+#include <memory>
 
 #define HARDWARE_FILE_MAGIC 0x68636e79734e5652
+#define HARDWARE_FILE_VERSION 2
 
 namespace reven {
 namespace vmghost {
 
 //! Contains the various hardware related traces.
+//!
+//! Two formats exist, both starting with the magic number and the version:
+//!  - Version 0 is a sequence of variable length records, each containing the fixed part of an access followed by
+//!    its data.
+//!  - Version 1 separates the fixed part of the accesses from their data. The header is followed by the number of
+//!    accesses, the offset of the metadata table and the offset of the payload heap. The metadata table contains
+//!    one fixed size entry per access, sorted by TSC, with the location of its data in the heap. This allows to
+//!    binary search the file and to scan the metadata without reading any data.
+//!  - Version 2 has the same layout as version 1, but the data is kept in the payload store of the file (see
+//!    payload_store), and the metadata entries contain the references of the payloads instead of heap offsets.
+//!
+//! For versions 1 and 2, file positions are the positions of the metadata entries.
 class hardware_file {
 public:
+	//! Size of the header of a version 1 file.
+	static constexpr std::uint64_t v1_header_size = 8 + 4 + 8 + 8 + 8;
+
+	//! Size of a metadata entry of a version 1 file.
+	static constexpr std::uint64_t v1_entry_size = 8 + 8 + 8 + 8 + 4 + 8 + 8;
+
 	//! Default constructor
 	hardware_file();
 
 	bool load(const std::string& file_name);
 
+	//! The loaded file's version number.
+	std::uint32_t version() const { return version_; }
+
+	//! Number of threads used to decode the payloads of the batches of version 2 files. 0 means one per CPU.
+	//! Defaults to 1.
+	void set_threads(unsigned threads) { threads_ = threads; }
+
 	const hardware_access& current() const { return current_; }
 
 	const hardware_access& next();
 
+	//! Retrieves the next access selected by the filter.
+	//!
+	//! Only the fixed part of the rejected accesses is read, their data is skipped. position() still counts them.
+	const hardware_access& next(const hardware_filter& filter);
+
+	//! Reads up to count accesses at once, appending them to the batch. Returns the number of accesses read.
+	//!
+	//! Afterwards, current() is the last access read, and position() and file_position() are updated as if next()
+	//! had been called for each access.
+	std::size_t read_batch(hardware_batch& batch, std::size_t count);
+
+	//! Reads all the accesses up to the first one whose TSC is greater or equal to tsc, appending them to the batch.
+	//! Returns the number of accesses read.
+	//!
+	//! The access that stopped the read is not consumed: it will be returned by the next read.
+	//! Same as read_batch for the state of the file.
+	std::size_t read_until_tsc(hardware_batch& batch, std::uint64_t tsc);
+
 	void advance_to(std::uint64_t file_position, std::uint64_t position);
 
+	//! Moves the file so that current() is the first access whose TSC is greater or equal to tsc.
+	//! Returns false if there is no such access.
+	//!
+	//! Version 1 files are binary searched. Version 0 files may not be sorted, they are scanned from the start: use a
+	//! hardware_index on them instead.
+	bool seek_tsc(std::uint64_t tsc);
+
 	std::uint64_t file_position() const { return last_read_position_; }
 	std::uint64_t position() const { return position_; }
 
 	void sync_with(const hardware_file& other);
 
 private:
+	//! Reads the fixed part of the next access and the size of its data. Returns false at the end of the file.
+	bool read_header(hardware_access_header& header, std::uint64_t& length);
+
+	//! Reads the data of the access whose header was just read. Returns the number of bytes read.
+	std::uint64_t read_data(std::uint8_t* destination, std::uint64_t length);
+
+	//! Skips the data of the access whose header was just read.
+	void skip_data(std::uint64_t length);
+
+	//! Moves the file to the access record at the specified position, without reading it.
+	void seek_record(std::uint64_t file_position);
+
+	//! Reads the next access into the batch. If has_tsc_limit is set and the access's TSC is not lower than tsc_limit,
+	//! the access is not read.
+	bool read_into(hardware_batch& batch, bool has_tsc_limit, std::uint64_t tsc_limit);
+
+	//! Decodes the payloads of the accesses that were just read into the batch.
+	void decode_pending_payloads(hardware_batch& batch);
+
+	//! Updates the state of the file after the last batch read.
+	void finish_batch(const hardware_batch& batch, std::size_t count);
+
 	//! File that contains the io information.
 	streamable_file file_;
 
+	std::uint32_t version_;
+
+	//! Version 1 only: the file is also opened a second time to read the payload heap, so that reading both the
+	//! metadata table and the heap sequentially does not need any seek.
+	streamable_file heap_file_;
+
+	//! Versions 1 and 2.
+	std::uint64_t record_count_;
+	std::uint64_t table_offset_;
+	std::uint64_t heap_offset_;
+
+	//! Versions 1 and 2: index of the next metadata entry.
+	std::uint64_t record_index_;
+
+	//! Versions 1 and 2: location in the heap, or reference in the payload store, of the data of the last header read.
+	std::uint64_t data_offset_;
+
+	//! Version 1 only: position of heap_file_.
+	std::uint64_t heap_position_;
+
+	//! Version 2 only.
+	std::shared_ptr<const payload_store> payloads_;
+	unsigned threads_;
+
+	//! Version 2 only: payloads of the current batch that remain to be decoded.
+	std::vector<payload_store::request> pending_payloads_;
+
 	hardware_access current_;
 
 	std::uint64_t last_read_position_;
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "hardware_access.h"
+
+#include <cstdint>
+
+namespace reven {
+namespace vmghost {
+
+//! Selects hardware accesses on their fixed fields only, so that the data of the rejected ones need not be read.
+//!
+//! By default, every access matches. Ranges are half-open: [begin, end).
+struct hardware_filter {
+	//! Type bits (see hardware_access_header::hardware_access_type) that must all be set.
+	std::uint64_t required_types = 0;
+
+	//! Type bits that must all be unset.
+	std::uint64_t excluded_types = 0;
+
+	bool any_device = true;
+	std::uint64_t device_id = 0;
+
+	bool any_instance = true;
+	std::uint32_t device_instance = 0;
+
+	//! The access must overlap this physical range.
+	std::uint64_t address_begin = 0;
+	std::uint64_t address_end = UINT64_MAX;
+
+	std::uint64_t tsc_begin = 0;
+	std::uint64_t tsc_end = UINT64_MAX;
+
+	//! Only keep the accesses of the specified device, whatever the instance.
+	hardware_filter& only_device(std::uint64_t id)
+	{
+		any_device = false;
+		device_id = id;
+		return *this;
+	}
+
+	//! Only keep the accesses of the specified device instance.
+	hardware_filter& only_device(std::uint64_t id, std::uint32_t instance)
+	{
+		only_device(id);
+		any_instance = false;
+		device_instance = instance;
+		return *this;
+	}
+
+	//! Returns true if the access, whose data is length bytes long, is selected.
+	bool matches(const hardware_access_header& access, std::uint64_t length) const
+	{
+		std::uint64_t access_end = access.physical_address + (length ? length : 1);
+
+		return (access.type & required_types) == required_types && (access.type & excluded_types) == 0 &&
+		       (any_device || access.device_id == device_id) &&
+		       (any_instance || access.device_instance == device_instance) &&
+		       access.physical_address < address_end && access_end > address_begin && access.tsc >= tsc_begin &&
+		       access.tsc < tsc_end;
+	}
+};
+}
+} // namespace reven::vmghost
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "file_stamp.h"
+#include "hardware_file.h"
+
+#include <string>
+#include <vector>
+
+#define HARDWARE_INDEX_MAGIC 0x78636e79734e5652
+#define HARDWARE_INDEX_VERSION 0
+
+namespace reven {
+namespace vmghost {
+
+//! Sparse index of a hardware file, allowing to seek to an access by its ordinal or by its TSC.
+//!
+//! Hardware records are variable length, so the index keeps the position of every interval-th access in the file.
+//! A seek is then a lookup in the index followed by a scan of at most interval accesses.
+//! The index is stored next to the hardware file, and is only used if the hardware file did not change since.
+class hardware_index {
+public:
+	struct entry {
+		//! Number of accesses before this one in the file.
+		std::uint64_t ordinal;
+
+		//! Position of the access record in the hardware file.
+		std::uint64_t file_position;
+
+		//! TSC of the access.
+		std::uint64_t tsc;
+
+		//! Highest TSC of all the accesses before this one.
+		//! Hardware files are not necessarily sorted, this is what allows to seek by TSC anyway.
+		std::uint64_t preceding_max_tsc;
+	};
+
+	hardware_index();
+
+	//! Name of the index file of the specified hardware file.
+	static std::string index_file_name(const std::string& hardware_file_name);
+
+	//! Indexes the specified hardware file in a single pass. Returns false if the file cannot be read.
+	bool build(const std::string& hardware_file_name, std::uint64_t interval = 1024);
+
+	//! Loads the index of the specified hardware file. Returns false if there is no index, if it is out of date,
+	//! or if the file is not an index.
+	bool load(const std::string& hardware_file_name);
+
+	//! Writes the index next to the hardware file it was built from. Returns false on error.
+	bool save() const;
+
+	//! Loads the index of the specified hardware file, building and saving it if necessary.
+	bool load_or_build(const std::string& hardware_file_name, std::uint64_t interval = 1024);
+
+	//! Total number of accesses in the hardware file.
+	std::uint64_t count() const { return count_; }
+
+	//! Number of accesses between two entries.
+	std::uint64_t interval() const { return interval_; }
+
+	const std::vector<entry>& entries() const { return entries_; }
+
+	//! Returns the closest entry at or before the specified access ordinal.
+	const entry& lookup_ordinal(std::uint64_t ordinal) const;
+
+	//! Returns the entry from which to scan to find the first access whose TSC is greater or equal to tsc.
+	const entry& lookup_tsc(std::uint64_t tsc) const;
+
+	//! Moves the file so that current() is the access with the specified ordinal (the first one being 0).
+	//! Returns false if there is no such access.
+	bool seek(hardware_file& file, std::uint64_t ordinal) const;
+
+	//! Moves the file so that current() is the first access whose TSC is greater or equal to tsc.
+	//! Returns false if there is no such access.
+	bool seek_tsc(hardware_file& file, std::uint64_t tsc) const;
+
+private:
+	std::string hardware_file_name_;
+	file_stamp stamp_;
+
+	std::uint64_t interval_;
+	std::uint64_t count_;
+
+	std::vector<entry> entries_;
+}; // class hardware_index
+}
+} // namespace reven::vmghost
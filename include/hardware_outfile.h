@@ -0,0 +1,66 @@
+#pragma once
+
+#include "hardware_access.h"
+#include "hardware_file.h"
+#include "payload_store.h"
+#include "streamable_outfile.h"
+
+#include <string>
+
+namespace reven {
+namespace vmghost {
+
+//! Writes a hardware file that can be read back with hardware_file.
+//!
+//! Version 1 and 2 files require the accesses to be written in TSC order, write throws otherwise. Their metadata table
+//! is written to "<file>.table" until the file is closed, then appended to the data, and removed if the file is
+//! destroyed without being closed, e.g. after write threw. The data of version 2 files is written to their payload
+//! store.
+class hardware_outfile {
+public:
+	hardware_outfile();
+	~hardware_outfile();
+
+	//! Creates the specified file and writes its header. Returns false if the file cannot be created.
+	bool open(const std::string& file_name, std::uint32_t version = 0);
+
+	std::uint32_t version() const { return version_; }
+
+	//! Whether the payload store of version 2 files is compressed. Must be set before opening the file.
+	void set_payload_compression(bool compression) { payloads_.set_compression(compression); }
+
+	//! Payload store of version 2 files, e.g. for its statistics.
+	const payload_store_writer& payloads() const { return payloads_; }
+
+	void write(const hardware_access& access);
+
+	//! Writes an access whose data is stored elsewhere, e.g. in a mapping.
+	void write(const hardware_access_header& header, const std::uint8_t* data, std::uint64_t length);
+
+	void write(const hardware_access_view& access) { write(access, access.data, access.length); }
+
+	//! Number of accesses written so far.
+	std::uint64_t count() const { return count_; }
+
+	//! Closes the file. Returns false if an error occurred while writing.
+	bool close();
+
+private:
+	streamable_outfile out_;
+
+	std::string file_name_;
+	std::uint32_t version_;
+
+	//! Metadata table of version 1 files.
+	streamable_outfile table_;
+
+	payload_store_writer payloads_;
+
+	//! Size of the data written so far in version 1 files.
+	std::uint64_t heap_size_;
+	std::uint64_t last_tsc_;
+
+	std::uint64_t count_;
+}; // class hardware_outfile
+}
+} // namespace reven::vmghost
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "file_stamp.h"
+#include "hardware_file.h"
+
+#include <string>
+#include <vector>
+
+#define HARDWARE_PAGE_INDEX_MAGIC 0x67636e79734e5652
+#define HARDWARE_PAGE_INDEX_VERSION 1
+
+namespace reven {
+namespace vmghost {
+
+//! Index of the accesses of a hardware file by the physical pages they touch.
+//!
+//! Answers "which accesses touched this physical range, and when" without scanning the hardware file. An access is
+//! indexed once for every page it covers, so a big PCI write spanning several pages is found from any of them. Port
+//! accesses do not touch the main memory and are not indexed.
+//!
+//! The index is stored next to the hardware file, and is only used if the hardware file did not change since.
+class hardware_page_index {
+public:
+	static constexpr unsigned page_shift = 12;
+
+	struct entry {
+		std::uint64_t page;
+		std::uint64_t tsc;
+
+		//! Number of accesses before this one in the hardware file.
+		std::uint64_t ordinal;
+
+		//! Position of the access record in the hardware file.
+		std::uint64_t file_position;
+
+		//! Range of the access.
+		std::uint64_t address;
+		std::uint64_t length;
+	};
+
+	//! Name of the page index file of the specified hardware file.
+	static std::string index_file_name(const std::string& hardware_file_name);
+
+	//! Indexes the specified hardware file, sorting the index on the specified number of threads (0 for one per CPU).
+	//! Returns false if the file cannot be read.
+	bool build(const std::string& hardware_file_name, unsigned threads = 0);
+
+	//! Loads the index of the specified hardware file. Returns false if there is no index, if it is out of date,
+	//! or if the file is not an index.
+	bool load(const std::string& hardware_file_name);
+
+	//! Writes the index next to the hardware file it was built from. Returns false on error.
+	bool save() const;
+
+	//! Loads the index of the specified hardware file, building and saving it if necessary.
+	bool load_or_build(const std::string& hardware_file_name, unsigned threads = 0);
+
+	//! All the (page, access) pairs, sorted by page then TSC.
+	const std::vector<entry>& entries() const { return entries_; }
+
+	//! Returns the accesses that overlap the physical range [address, address + length), once each, sorted by TSC
+	//! then by position in the file. An empty range or access counts as a single byte. The page member of the results
+	//! is the first page of the range touched by the access.
+	//!
+	//! Use hardware_file::advance_to(result.file_position, result.ordinal + 1) to read an access.
+	std::vector<entry> query(std::uint64_t address, std::uint64_t length) const;
+
+private:
+	std::string hardware_file_name_;
+	file_stamp stamp_;
+
+	std::vector<entry> entries_;
+}; // class hardware_page_index
+}
+} // namespace reven::vmghost
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "streamable_file.h"
+#include "streamable_outfile.h"
+
+namespace reven {
+namespace vmghost {
+
+//! Byte buffer holding the data of a hardware access.
+//!
+//! Most accesses are MMIO or port accesses of at most 8 bytes, so small payloads are stored inline without any heap
+//! allocation. Only the bigger buffers (typically PCI) are allocated on the heap.
+//! The interface is a subset of std::vector<std::uint8_t>.
+class hardware_payload {
+public:
+	//! Payloads up to this size are stored inline.
+	static constexpr std::size_t inline_capacity = 16;
+
+	hardware_payload() : size_(0) {}
+	hardware_payload(const std::uint8_t* first, const std::uint8_t* last);
+	hardware_payload(const hardware_payload& other);
+	hardware_payload(hardware_payload&& other) noexcept;
+	~hardware_payload() { release(); }
+
+	hardware_payload& operator=(const hardware_payload& other);
+	hardware_payload& operator=(hardware_payload&& other) noexcept;
+
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	std::uint8_t* data() { return is_inline() ? inline_ : heap_; }
+	const std::uint8_t* data() const { return is_inline() ? inline_ : heap_; }
+
+	std::uint8_t* begin() { return data(); }
+	std::uint8_t* end() { return data() + size_; }
+	const std::uint8_t* begin() const { return data(); }
+	const std::uint8_t* end() const { return data() + size_; }
+
+	std::uint8_t& operator[](std::size_t index) { return data()[index]; }
+	const std::uint8_t& operator[](std::size_t index) const { return data()[index]; }
+
+	//! Resizes the buffer, keeping its content. New bytes are zeroed.
+	void resize(std::size_t size);
+
+	void assign(const std::uint8_t* first, const std::uint8_t* last);
+
+	void clear() { resize(0); }
+
+private:
+	bool is_inline() const { return size_ <= inline_capacity; }
+
+	void release()
+	{
+		if (not is_inline())
+			delete[] heap_;
+	}
+
+	std::size_t size_;
+
+	union {
+		std::uint8_t inline_[inline_capacity];
+		std::uint8_t* heap_;
+	};
+}; // class hardware_payload
+
+bool operator==(const hardware_payload& lhs, const hardware_payload& rhs);
+inline bool operator!=(const hardware_payload& lhs, const hardware_payload& rhs) { return !(lhs == rhs); }
+
+inline streamable_file& operator>>(streamable_file& in, hardware_payload& data)
+{
+	std::uint64_t size;
+	in >> size;
+	data.clear();
+	if (in.eof() || size == 0)
+		return in;
+
+	in.check_container_size(size);
+
+	data.resize(size);
+	data.resize(in.read_bulk(reinterpret_cast<char*>(data.data()), size));
+	return in;
+}
+
+inline streamable_outfile& operator<<(streamable_outfile& out, const hardware_payload& data)
+{
+	std::uint64_t size = data.size();
+	out << size;
+
+	out.write_raw(reinterpret_cast<const char*>(data.data()), size);
+	return out;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "hardware_access.h"
+#include "sync_file.h"
+
+#include <deque>
+#include <string>
+
+namespace reven {
+namespace vmghost {
+
+class hardware_outfile;
+
+//! Removes the hardware writes that nobody can observe.
+//!
+//! The CPU can only observe memory at the sync points. Between two of them, a write whose bytes are all written
+//! again by later writes before the next sync point is dead: replaying it has no visible effect. The pruner copies a
+//! hardware file without its dead writes.
+//!
+//! Reads and MMIO accesses observe memory as well, they end the current interval just like sync points do. Accesses
+//! at the exact TSC of a sync point are never pruned, nor used to prune others, since their order relative to the sync
+//! point is unknown. Port accesses do not touch memory and are kept.
+//!
+//! The analysis is streaming: only the accesses of the current interval are kept in memory, up to the memory budget.
+//! Beyond it, the oldest accesses are written out as-is, so a long interval only makes the pruning less effective.
+//!
+//! The hardware file must be sorted by TSC (see reorder_hardware), the pruner throws otherwise.
+class hardware_pruner {
+public:
+	hardware_pruner();
+
+	//! Maximum size of the data of the accesses kept in memory, in bytes. Defaults to 64 MiB.
+	void set_memory_budget(std::uint64_t bytes) { memory_budget_ = bytes; }
+	std::uint64_t memory_budget() const { return memory_budget_; }
+
+	//! Version of the pruned hardware file. Defaults to 0.
+	void set_output_version(std::uint32_t version) { output_version_ = version; }
+	std::uint32_t output_version() const { return output_version_; }
+
+	//! Prunes source into destination, using the sync points of sync as observation points.
+	//! Returns false if source cannot be read or destination cannot be written.
+	bool prune(const std::string& source, sync_file& sync, const std::string& destination);
+
+	//! Number of accesses read, and number of accesses pruned, during the last prune.
+	std::uint64_t accesses() const { return accesses_; }
+	std::uint64_t pruned_accesses() const { return pruned_accesses_; }
+
+	//! Size of the data of the accesses read, and of the accesses pruned, during the last prune.
+	std::uint64_t bytes() const { return bytes_; }
+	std::uint64_t pruned_bytes() const { return pruned_bytes_; }
+
+private:
+	struct pending_access {
+		hardware_access access;
+
+		//! False for accesses that cannot be pruned.
+		bool prunable;
+	};
+
+	void push(const hardware_access& access, bool prunable, hardware_outfile& out);
+
+	//! Writes the live accesses of the current interval and starts a new one.
+	void flush(hardware_outfile& out);
+
+	std::uint64_t memory_budget_;
+	std::uint32_t output_version_;
+
+	std::deque<pending_access> pending_;
+	std::uint64_t pending_bytes_;
+
+	std::uint64_t accesses_;
+	std::uint64_t pruned_accesses_;
+	std::uint64_t bytes_;
+	std::uint64_t pruned_bytes_;
+}; // class hardware_pruner
+}
+} // namespace reven::vmghost
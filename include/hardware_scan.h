@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mapped_hardware_file.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Consecutive access records of a hardware mapping.
+struct hardware_record_range {
+	//! Offset of the first record of the range, and of the first record after it.
+	std::uint64_t begin;
+	std::uint64_t end;
+
+	//! Number of accesses before the range in the file, and in the range.
+	std::uint64_t first_ordinal;
+	std::uint64_t count;
+};
+
+//! Splits the access records of a mapping into at most parts ranges of about the same size, to be read in parallel,
+//! using the specified number of threads (0 for one per CPU).
+//!
+//! Reading stops at the first invalid access, as a sequential read does: the ranges end before it.
+//!
+//! Version 1 and 2 files have fixed size records, and are split directly, but each part is still walked to find its
+//! invalid entries, if any. Version 0 records have a variable size and
+//! no index: each thread guesses the first record boundary of its part of the file, by looking for a chain of records
+//! with valid types, lengths that fit in the file and close TSCs. Each thread then walks the record headers of its
+//! part, and the boundaries are checked at the seams: a wrong guess is replaced by the boundary the previous part
+//! actually ended on, and that part is walked again from there. The result is always the same as a sequential read,
+//! down to a file truncated in the middle of a record. Parts that contain no boundary are merged with the previous
+//! one, so small files or files made of a few huge records end up in a single range.
+//!
+//! Read a range with mapped_hardware_file::advance_to(range.begin, 0), until file_position() reaches range.end.
+std::vector<hardware_record_range> split_hardware_records(const hardware_mapping& mapping, unsigned parts,
+                                                          unsigned threads = 0);
+}
+} // namespace reven::vmghost
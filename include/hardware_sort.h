@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+class hardware_mapping;
+class hardware_outfile;
+
+//! Locates an access record of a hardware file, for sorting purposes.
+struct hardware_sort_key {
+	std::uint64_t tsc;
+
+	//! Position of the access record in the hardware file.
+	std::uint64_t file_position;
+
+	//! Size of the whole access record, data included.
+	std::uint64_t record_size;
+};
+
+//! Sorts the keys by TSC using a parallel LSD radix sort.
+//! The sort is stable: keys with the same TSC keep their order.
+void parallel_radix_sort(std::vector<hardware_sort_key>& keys, unsigned threads);
+
+//! Sorts the accesses of a hardware file by TSC, without loading the accesses in memory.
+//!
+//! Only the sort keys are kept in memory, and they are sorted in runs that are spilled to temporary files when they
+//! exceed the memory budget. The runs are then merged, and each access is copied from the source file to the
+//! destination, in the output version.
+//!
+//! Accesses with the same TSC keep the order they had in the source file.
+class hardware_sorter {
+public:
+	hardware_sorter();
+
+	//! Maximum amount of memory used for the sort keys, in bytes.
+	void set_memory_budget(std::uint64_t bytes) { memory_budget_ = bytes; }
+	std::uint64_t memory_budget() const { return memory_budget_; }
+
+	//! Number of threads used to sort the runs. 0 means one per CPU.
+	void set_threads(unsigned threads) { threads_ = threads; }
+	unsigned threads() const { return threads_; }
+
+	//! If not 0, first attempts to sort the file in a single streaming pass, assuming accesses are out of order by
+	//! less than window accesses (see reorder_window). Falls back to a full sort if this is not the case.
+	void set_window(std::uint64_t window) { window_ = window; }
+	std::uint64_t window() const { return window_; }
+
+	//! Version of the sorted hardware file. Defaults to 0.
+	void set_output_version(std::uint32_t version) { output_version_ = version; }
+	std::uint32_t output_version() const { return output_version_; }
+
+	//! Whether the payload store of version 2 output is compressed. Defaults to true.
+	void set_payload_compression(bool compression) { payload_compression_ = compression; }
+
+	//! Number of runs that were spilled to disk during the last sort.
+	std::uint64_t spilled_runs() const { return spilled_runs_; }
+
+	//! True if the last sort could not be done in a streaming pass.
+	bool fell_back() const { return fell_back_; }
+
+	//! Sorts source into destination. Temporary files are created next to destination.
+	//! Returns false if source cannot be read or destination cannot be written.
+	bool sort(const std::string& source, const std::string& destination);
+
+private:
+	//! Sorts source in a single pass using a reorder_window. Returns false if the disorder exceeds the window.
+	bool sort_streaming(const hardware_mapping& mapping, hardware_outfile& out);
+
+	//! Sorts source with a full sort of the accesses, spilling to disk if needed.
+	void sort_full(const hardware_mapping& mapping, hardware_outfile& out, const std::string& destination);
+
+	std::uint64_t memory_budget_;
+	unsigned threads_;
+	std::uint64_t window_;
+	std::uint32_t output_version_;
+	bool payload_compression_;
+	std::uint64_t spilled_runs_;
+	bool fell_back_;
+}; // class hardware_sorter
+}
+} // namespace reven::vmghost
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "file_stamp.h"
+#include "streamable_file.h"
+#include "streamable_outfile.h"
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Reads the header of an index file: its magic number, its version, and the stamp of the file it was built from.
+//! Returns false if the file is not an index with this magic number, if it has another version, or if it was built
+//! from another version of the indexed file. In all these cases, the index is just rebuilt.
+bool read_index_header(streamable_file& file, std::uint64_t magic, std::uint32_t version,
+                       const file_stamp& current_stamp);
+
+//! Writes the header read by read_index_header.
+void write_index_header(streamable_outfile& out, std::uint64_t magic, std::uint32_t version, const file_stamp& stamp);
+
+//! Reads the name and stamp of another file the index was built from, e.g. the sync file of a hardware file index.
+//! Returns false if they do not match the specified ones.
+bool read_indexed_file(streamable_file& file, const std::string& file_name, const file_stamp& current_stamp);
+
+//! Writes the name and stamp read by read_indexed_file.
+void write_indexed_file(streamable_outfile& out, const std::string& file_name, const file_stamp& stamp);
+
+//! Number of bytes left to read in the file.
+std::uint64_t remaining_size(streamable_file& file);
+
+//! Reads a vector of plain values written by write_index_vector, all at once.
+//! Returns false if the file is too short for the number of values it claims: unlike the containers of the other
+//! files, an index can legitimately be bigger than streamable_file::max_container_size.
+template <typename T> bool read_index_vector(streamable_file& file, std::vector<T>& values)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Index vectors are read as raw bytes");
+
+	values.clear();
+
+	std::uint64_t count;
+	file >> count;
+
+	if (file.eof() || count > remaining_size(file) / sizeof(T))
+		return false;
+
+	values.resize(count);
+
+	std::uint64_t size = count * sizeof(T);
+	if (file.read_bulk(reinterpret_cast<char*>(values.data()), size) != size) {
+		values.clear();
+		return false;
+	}
+
+	return true;
+}
+
+//! Writes a vector of plain values, all at once.
+template <typename T> void write_index_vector(streamable_outfile& out, const std::vector<T>& values)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Index vectors are written as raw bytes");
+
+	std::uint64_t count = values.size();
+	out << count;
+	out.write_raw(reinterpret_cast<const char*>(values.data()), count * sizeof(T));
+}
+}
+} // namespace reven::vmghost
@@ -2,6 +2,7 @@
 
 #include "streamable_file.h"
 #include "device.h"
+#include "device_resolver.h"
 
 #include <map>
 
@@ -20,11 +21,16 @@ public:
 
 	const std::map<std::uint64_t, device>& devices() const { return devices_; }
 
+	//! Finds the device mapped at a port or physical address. Built when the file is loaded.
+	const device_resolver& resolver() const { return resolver_; }
+
 private:
 	//! File that contains the io information.
 	streamable_file file_;
 
 	std::map<std::uint64_t, device> devices_;
+
+	device_resolver resolver_;
 }; // class io_file
 }
 } // namespace reven::vmghost
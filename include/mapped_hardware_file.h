@@ -0,0 +1,127 @@
+#pragma once
+
+#include "hardware_access.h"
+#include "hardware_file.h"
+#include "hardware_filter.h"
+#include "payload_store.h"
+
+#include <memory>
+#include <string>
+
+namespace reven {
+namespace vmghost {
+
+//! A hardware file mapped in memory, read only.
+//!
+//! The mapping is shared by all the readers created on it, and is unmapped when the last one is destroyed.
+class hardware_mapping {
+public:
+	//! Size of the fixed part of an access record, including the length of the data.
+	static constexpr std::uint64_t record_header_size = 8 + 8 + 8 + 8 + 4 + 8;
+
+	//! Size of a record of the metadata table of version 1 files, which also holds the offset of the data.
+	static constexpr std::uint64_t table_entry_size = hardware_file::v1_entry_size;
+
+	~hardware_mapping();
+
+	hardware_mapping(const hardware_mapping&) = delete;
+	hardware_mapping& operator=(const hardware_mapping&) = delete;
+
+	//! Maps the specified file. Returns nullptr if the file cannot be opened or mapped, and throws if it is not a
+	//! hardware file.
+	static std::shared_ptr<const hardware_mapping> open(const std::string& file_name);
+
+	const std::uint8_t* begin() const { return base_; }
+	const std::uint8_t* end() const { return base_ + size_; }
+	std::uint64_t size() const { return size_; }
+
+	//! Version number of the file.
+	std::uint32_t version() const { return version_; }
+
+	//! Offset of the first access record. For version 1 files, this is the first entry of the metadata table.
+	std::uint64_t first_record() const { return first_record_; }
+
+	//! Offset of the end of the access records.
+	std::uint64_t records_end() const { return records_end_; }
+
+	//! Payload store of version 2 files, nullptr for the other versions.
+	const std::shared_ptr<const payload_store>& payloads() const { return payloads_; }
+
+	//! Decodes the access record at the specified offset into view.
+	//! Returns the offset of the next record, or 0 if there is no valid record at this offset.
+	//!
+	//! The data of version 2 files is not in the mapping: the data of the view is then nullptr.
+	std::uint64_t decode(std::uint64_t offset, hardware_access_view& view) const;
+
+	//! Same as above, but the data of version 2 files is decoded into buffer, which the view then points to.
+	//! Throws if the payload store is corrupted.
+	std::uint64_t decode(std::uint64_t offset, hardware_access_view& view, std::vector<std::uint8_t>& buffer) const;
+
+private:
+	hardware_mapping(const std::uint8_t* base, std::uint64_t size);
+
+	const std::uint8_t* base_;
+	std::uint64_t size_;
+	std::uint32_t version_;
+	std::uint64_t first_record_;
+	std::uint64_t records_end_;
+
+	//! Offset of the data of version 1 files.
+	std::uint64_t heap_offset_;
+
+	std::shared_ptr<const payload_store> payloads_;
+}; // class hardware_mapping
+
+//! Reads a hardware file through a memory mapping.
+//!
+//! Unlike hardware_file, nothing is copied out of the file: current() is a view whose data points into the mapping.
+//! Readers are cheap to copy, which allows to fork them, and sync_with is a plain copy of the cursor.
+//!
+//! The data of version 2 files is not in the mapping: it is decoded into a buffer of the reader, and the view points
+//! there until the next access is read.
+class mapped_hardware_file {
+public:
+	mapped_hardware_file();
+
+	mapped_hardware_file(const mapped_hardware_file& other);
+	mapped_hardware_file& operator=(const mapped_hardware_file& other);
+
+	//! Maps the specified file. Returns false if it cannot be opened.
+	bool load(const std::string& file_name);
+
+	//! Reads from an existing mapping, which is then shared with its other readers.
+	bool load(std::shared_ptr<const hardware_mapping> mapping);
+
+	const std::shared_ptr<const hardware_mapping>& mapping() const { return mapping_; }
+
+	const hardware_access_view& current() const { return current_; }
+
+	const hardware_access_view& next();
+
+	//! Retrieves the next access selected by the filter. The data of the rejected accesses is never touched.
+	const hardware_access_view& next(const hardware_filter& filter);
+
+	//! Same as hardware_file::advance_to.
+	void advance_to(std::uint64_t file_position, std::uint64_t position);
+
+	std::uint64_t file_position() const { return last_read_position_; }
+	std::uint64_t position() const { return position_; }
+
+	void sync_with(const mapped_hardware_file& other);
+
+private:
+	std::shared_ptr<const hardware_mapping> mapping_;
+
+	hardware_access_view current_;
+
+	//! Data of the current access, for version 2 files.
+	std::vector<std::uint8_t> payload_;
+
+	//! Offset of the next record to read.
+	std::uint64_t next_position_;
+
+	std::uint64_t last_read_position_;
+	std::uint64_t position_;
+}; // class mapped_hardware_file
+}
+} // namespace reven::vmghost
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "mapped_hardware_file.h"
+#include "sync_file.h"
+
+#include <bitset>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Physical memory as it was at any position of a sync file.
+//!
+//! The memory is known from the physical dumps of the sync points, in the data file, and from the writes of the
+//! hardware accesses. Logical dumps are not used: their addresses are virtual. The memory at a position is the result
+//! of the dumps of the sync points up to it, and of the hardware writes before its TSC, in TSC order, hardware writes
+//! last on ties (see timeline).
+//!
+//! The files are replayed once by build, which keeps a checkpoint of the memory every checkpoint_interval positions.
+//! A checkpoint only keeps a copy of the pages written since the previous one, so the memory used grows with the
+//! number of pages written in each interval, not with the size of the memory nor with the number of checkpoints
+//! times the pages touched. Reading the memory at a position then takes the last copy of each page read up to the
+//! checkpoint before it, and only replays from there the sync points and hardware writes that touch the bytes read.
+//!
+//! Defining RVN_MEMORY_HISTORY_DEBUG makes read check its result against a replay from the first position.
+//!
+//! The hardware file must be sorted by TSC (see reorder_hardware), build throws otherwise.
+class memory_history {
+public:
+	static constexpr unsigned page_shift = 12;
+	static constexpr std::uint64_t page_size = 1ull << page_shift;
+
+	memory_history();
+
+	//! Number of positions between two checkpoints. Defaults to 1024. Must be set before build.
+	void set_checkpoint_interval(std::uint64_t positions) { checkpoint_interval_ = positions; }
+	std::uint64_t checkpoint_interval() const { return checkpoint_interval_; }
+
+	//! Replays the specified files. The hardware file may be empty, for sync points only.
+	//! Returns false if a file cannot be read.
+	bool build(const std::string& sync_file_name, const std::string& data_file_name,
+	           const std::string& hardware_file_name);
+
+	//! Reads [address, address + length) as it was at the specified sync file position, which is clamped to the
+	//! last one. Position 0 is before the first sync point, when nothing is known.
+	//! Bytes that were never dumped nor written are set to 0, and the function then returns false.
+	bool read(std::uint64_t position, std::uint64_t address, std::uint64_t length, std::uint8_t* buffer);
+
+	//! Number of checkpoints kept, including the initial empty memory.
+	std::uint64_t checkpoint_count() const { return checkpoints_.size(); }
+
+	//! Last position of the sync file.
+	std::uint64_t last_position() const { return last_position_; }
+
+private:
+	struct page {
+		std::uint8_t bytes[page_size] = {};
+
+		//! Bytes whose value is known.
+		std::bitset<page_size> known;
+	};
+
+	//! Pages by page number. A page is shared with the checkpoints until it is written again.
+	using page_map = std::map<std::uint64_t, std::shared_ptr<page>>;
+
+	struct checkpoint {
+		std::uint64_t position;
+
+		//! Positioned on the first hardware access not replayed yet.
+		mapped_hardware_file hardware;
+	};
+
+	//! Content of a page from the checkpoint at position on, until the next version.
+	struct page_version {
+		std::uint64_t position;
+		std::shared_ptr<const page> content;
+	};
+
+	//! Writes into pages, copying the pages shared with the checkpoints first. The pages written for the first time
+	//! since the last checkpoint are added to dirty.
+	static void write(page_map& pages, std::vector<std::uint64_t>& dirty, std::uint64_t address,
+	                  const std::uint8_t* data, std::uint64_t length);
+
+	//! read, from the specified checkpoint on.
+	bool read_from(const checkpoint& start, std::uint64_t position, std::uint64_t address, std::uint64_t length,
+	               std::uint8_t* buffer);
+
+	std::uint64_t checkpoint_interval_;
+
+	sync_file sync_;
+	bool has_hardware_;
+	std::uint64_t last_position_;
+
+	std::deque<checkpoint> checkpoints_;
+
+	//! Versions of each page written, by page number, in order of position.
+	std::map<std::uint64_t, std::vector<page_version>> page_versions_;
+}; // class memory_history
+}
+} // namespace reven::vmghost
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define PAYLOAD_STORE_MAGIC 0x70636e79734e5652
+#define PAYLOAD_STORE_VERSION 0
+
+namespace reven {
+namespace vmghost {
+
+//! Stores the data of the accesses of a hardware file, deduplicated.
+//!
+//! Payloads are split in chunks of chunk_size bytes. Each distinct chunk is stored once, compressed if this makes it
+//! smaller, and a payload is stored as the list of the identifiers of its chunks. The location of this list is the
+//! reference of the payload, which is what the accesses record. Empty payloads have no list.
+//!
+//! The store is a file starting with a header (magic, version, chunk size, chunk count, offset of the chunk table),
+//! followed by the chunks and the lists, and ending with the chunk table. Each entry of the chunk table contains the
+//! offset of the chunk, its stored size and its size once decompressed: both sizes are equal if it is stored as-is.
+//!
+//! The store is read through a memory mapping, so that any payload can be decoded independently of the others, from
+//! any thread.
+class payload_store {
+public:
+	static constexpr std::uint32_t chunk_size = 4096;
+
+	//! A payload to decode.
+	struct request {
+		std::uint64_t reference;
+		std::uint64_t length;
+		std::uint8_t* destination;
+	};
+
+	//! Name of the store of the specified hardware file.
+	static std::string store_file_name(const std::string& hardware_file_name);
+
+	~payload_store();
+
+	payload_store(const payload_store&) = delete;
+	payload_store& operator=(const payload_store&) = delete;
+
+	//! Maps the specified store. Returns nullptr if it cannot be opened or mapped, and throws if it is not a store.
+	static std::shared_ptr<const payload_store> open(const std::string& file_name);
+
+	std::uint64_t chunk_count() const { return chunk_count_; }
+
+	//! Decodes the length bytes of the referenced payload into destination.
+	//! Returns false if the store is corrupted.
+	bool read(std::uint64_t reference, std::uint64_t length, std::uint8_t* destination) const;
+
+	//! Decodes all the requests, spread over the specified number of threads. 0 means one per CPU.
+	//! Returns false if the store is corrupted.
+	bool read(const std::vector<request>& requests, unsigned threads) const;
+
+private:
+	payload_store(const std::uint8_t* base, std::uint64_t size);
+
+	const std::uint8_t* base_;
+	std::uint64_t size_;
+	std::uint64_t chunk_count_;
+	std::uint64_t chunk_table_offset_;
+}; // class payload_store
+
+//! Writes a payload store.
+class payload_store_writer {
+public:
+	payload_store_writer();
+	~payload_store_writer();
+
+	payload_store_writer(const payload_store_writer&) = delete;
+	payload_store_writer& operator=(const payload_store_writer&) = delete;
+
+	//! Whether chunks are compressed. Defaults to true.
+	void set_compression(bool compression) { compression_ = compression; }
+	bool compression() const { return compression_; }
+
+	//! Creates the specified store. Returns false if it cannot be created.
+	bool open(const std::string& file_name);
+
+	//! Stores a payload and returns its reference.
+	std::uint64_t add(const std::uint8_t* data, std::uint64_t length);
+
+	//! Writes the chunk table and closes the store. Returns false if an error occurred while writing.
+	bool close();
+
+	//! Total size of the payloads added.
+	std::uint64_t payload_bytes() const { return payload_bytes_; }
+
+	//! Number of chunks added, and number of distinct chunks among them.
+	std::uint64_t chunk_references() const { return chunk_references_; }
+	std::uint64_t unique_chunks() const { return chunks_.size(); }
+
+	//! Size of the distinct chunks once stored.
+	std::uint64_t stored_bytes() const { return stored_bytes_; }
+
+private:
+	struct chunk {
+		std::uint64_t offset;
+		std::uint32_t stored_size;
+		std::uint32_t raw_size;
+	};
+
+	//! Returns the identifier of the chunk, storing it if it is new.
+	std::uint32_t add_chunk(const std::uint8_t* data, std::uint32_t length);
+
+	//! Returns true if the stored chunk has the specified content.
+	bool chunk_equals(std::uint32_t id, std::uint64_t hash, const std::uint8_t* data, std::uint32_t length);
+
+	//! Reads back a stored chunk, decompressed.
+	void read_chunk(std::uint32_t id, std::vector<std::uint8_t>& data);
+
+	void write(const void* data, std::uint64_t length);
+	void flush();
+
+	int fd_;
+	bool compression_;
+	bool good_;
+
+	//! Everything before written_ is in the file, the rest is in buffer_.
+	std::uint64_t written_;
+	std::vector<std::uint8_t> buffer_;
+
+	std::vector<chunk> chunks_;
+
+	//! Chunk identifiers by hash. Chunks with the same hash are compared before being shared.
+	std::unordered_multimap<std::uint64_t, std::uint32_t> chunk_ids_;
+
+	//! Content of recently used chunks, by hash, to avoid reading them back when comparing.
+	struct cached_chunk {
+		std::uint32_t id;
+		std::vector<std::uint8_t> data;
+	};
+	std::vector<cached_chunk> cache_;
+
+	std::vector<std::uint8_t> compressed_;
+	std::vector<std::uint32_t> ids_;
+
+	std::uint64_t payload_bytes_;
+	std::uint64_t chunk_references_;
+	std::uint64_t stored_bytes_;
+}; // class payload_store_writer
+}
+} // namespace reven::vmghost
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Sorts a stream of elements by TSC, assuming each element is out of order by less than capacity elements.
+//!
+//! Hardware files are almost sorted: accesses are only locally inverted (see hardware_access_header::tsc). The window
+//! keeps the last capacity elements in a min-heap, and once it is full every new element releases the lowest one.
+//! Elements with the same TSC are released in the order they were pushed.
+//!
+//! If an element is pushed after an element with a higher TSC was already released, the disorder exceeds the window
+//! and the stream cannot be sorted that way: push returns false.
+//!
+//! T must have a tsc member.
+template <typename T> class reorder_window {
+public:
+	explicit reorder_window(std::size_t capacity) : capacity_(capacity ? capacity : 1), sequence_(0), last_tsc_(0) {}
+
+	//! Adds an element to the window. Returns false if the element should have been released already.
+	bool push(T element)
+	{
+		if (element.tsc < last_tsc_)
+			return false;
+
+		heap_.push(item{std::move(element), sequence_++});
+		return true;
+	}
+
+	//! True if an element has to be released before pushing a new one.
+	bool full() const { return heap_.size() >= capacity_; }
+
+	bool empty() const { return heap_.empty(); }
+	std::size_t size() const { return heap_.size(); }
+
+	//! The lowest element of the window.
+	const T& top() const { return heap_.top().element; }
+
+	//! Releases the lowest element of the window.
+	T pop()
+	{
+		T element = std::move(const_cast<item&>(heap_.top()).element);
+		heap_.pop();
+		last_tsc_ = element.tsc;
+		return element;
+	}
+
+	//! TSC of the last element released.
+	std::uint64_t last_tsc() const { return last_tsc_; }
+
+private:
+	struct item {
+		T element;
+		std::uint64_t sequence;
+	};
+
+	struct item_greater {
+		bool operator()(const item& lhs, const item& rhs) const
+		{
+			return lhs.element.tsc > rhs.element.tsc ||
+			       (lhs.element.tsc == rhs.element.tsc && lhs.sequence > rhs.sequence);
+		}
+	};
+
+	std::size_t capacity_;
+	std::uint64_t sequence_;
+	std::uint64_t last_tsc_;
+
+	std::priority_queue<item, std::vector<item>, item_greater> heap_;
+}; // class reorder_window
+}
+} // namespace reven::vmghost
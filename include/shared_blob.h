@@ -0,0 +1,67 @@
+#pragma once
+
+#include "streamable_file.h"
+#include "streamable_outfile.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Immutable byte buffer, shared by all its copies.
+//!
+//! Copying a blob only copies a handle, which makes the memory dumps of the sync points cheap to aggregate into events
+//! and to keep around. Identical blobs can share a single buffer through a blob_pool.
+//! The interface is a const subset of std::vector<std::uint8_t>.
+class shared_blob {
+public:
+	shared_blob() = default;
+	explicit shared_blob(std::vector<std::uint8_t>&& bytes)
+	  : bytes_(bytes.empty() ? nullptr : std::make_shared<const std::vector<std::uint8_t>>(std::move(bytes)))
+	{
+	}
+	explicit shared_blob(std::shared_ptr<const std::vector<std::uint8_t>> bytes) : bytes_(std::move(bytes)) {}
+
+	std::size_t size() const { return bytes_ ? bytes_->size() : 0; }
+	bool empty() const { return size() == 0; }
+
+	const std::uint8_t* data() const { return bytes_ ? bytes_->data() : nullptr; }
+
+	const std::uint8_t* begin() const { return data(); }
+	const std::uint8_t* end() const { return data() + size(); }
+
+	const std::uint8_t& operator[](std::size_t index) const { return data()[index]; }
+
+	//! True if both blobs share the same buffer.
+	bool shares_with(const shared_blob& other) const { return bytes_ == other.bytes_; }
+
+private:
+	std::shared_ptr<const std::vector<std::uint8_t>> bytes_;
+}; // class shared_blob
+
+inline bool operator==(const shared_blob& lhs, const shared_blob& rhs)
+{
+	return lhs.shares_with(rhs) || (lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0);
+}
+inline bool operator!=(const shared_blob& lhs, const shared_blob& rhs) { return !(lhs == rhs); }
+
+inline streamable_file& operator>>(streamable_file& in, shared_blob& data)
+{
+	std::vector<std::uint8_t> bytes;
+	in >> bytes;
+	data = shared_blob(std::move(bytes));
+	return in;
+}
+
+inline streamable_outfile& operator<<(streamable_outfile& out, const shared_blob& data)
+{
+	std::uint64_t size = data.size();
+	out << size;
+
+	out.write_raw(reinterpret_cast<const char*>(data.data()), size);
+	return out;
+}
+}
+} // namespace reven::vmghost
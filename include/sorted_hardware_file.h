@@ -0,0 +1,38 @@
+#pragma once
+
+#include "hardware_file.h"
+#include "reorder_window.h"
+
+namespace reven {
+namespace vmghost {
+
+//! Reads a hardware file in TSC order without reordering it first.
+//!
+//! Relies on hardware files being almost sorted: accesses are sorted on the fly in a window of the specified size.
+//! Throws if an access is out of order by more than the window, in which case the file has to be reordered with
+//! reorder_hardware: the accesses returned so far were in order, but that one should have been returned before.
+class sorted_hardware_file {
+public:
+	explicit sorted_hardware_file(std::size_t window_size = 4096);
+
+	bool load(const std::string& file_name);
+
+	const hardware_access& current() const { return current_; }
+
+	const hardware_access& next();
+
+	//! Number of accesses returned so far.
+	std::uint64_t position() const { return position_; }
+
+private:
+	hardware_file file_;
+
+	std::size_t window_size_;
+	reorder_window<hardware_access> window_;
+
+	hardware_access current_;
+
+	std::uint64_t position_;
+}; // class sorted_hardware_file
+}
+} // namespace reven::vmghost
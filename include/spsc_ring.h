@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Bounded lock-free queue between exactly one producer thread and one consumer thread.
+//!
+//! The slots are allocated once and reused: the producer fills the slot returned by back() in place and publishes it
+//! with push(), the consumer reads the slot returned by front() in place and releases it with pop(). Neither side
+//! allocates, locks nor makes a system call.
+//!
+//! T must be default constructible.
+template <typename T> class spsc_ring {
+public:
+	//! The capacity is rounded up to a power of two.
+	explicit spsc_ring(std::size_t capacity) : head_(0), tail_(0)
+	{
+		std::size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		slots_.resize(size);
+		mask_ = size - 1;
+	}
+
+	std::size_t capacity() const { return slots_.size(); }
+
+	//! Producer: the slot to fill next, nullptr if the ring is full.
+	T* back()
+	{
+		std::uint64_t head = head_.load(std::memory_order_relaxed);
+		if (head - tail_.load(std::memory_order_acquire) == slots_.size())
+			return nullptr;
+		return &slots_[head & mask_];
+	}
+
+	//! Producer: publishes the slot returned by back().
+	void push() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	//! Consumer: the oldest published slot, nullptr if the ring is empty.
+	T* front()
+	{
+		std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+		if (head_.load(std::memory_order_acquire) == tail)
+			return nullptr;
+		return &slots_[tail & mask_];
+	}
+
+	//! Consumer: releases the slot returned by front(), which the producer may then overwrite.
+	void pop() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	//! Number of slots published and not popped yet.
+	std::size_t size() const
+	{
+		return static_cast<std::size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+	}
+
+	bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+	bool full() const
+	{
+		return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire) == slots_.size();
+	}
+
+	//! Drops the published slots. Neither side may use the ring meanwhile.
+	void clear() { tail_.store(head_.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+
+private:
+	std::vector<T> slots_;
+	std::size_t mask_;
+
+	//! Number of slots pushed and popped since the creation of the ring. Kept on different cache lines, as each is
+	//! written by one side and read by the other.
+	char head_padding_[64];
+	std::atomic<std::uint64_t> head_;
+	char tail_padding_[64];
+	std::atomic<std::uint64_t> tail_;
+}; // class spsc_ring
+}
+} // namespace reven::vmghost
@@ -3,6 +3,9 @@
 #include <fstream>
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include <iostream>
@@ -24,6 +27,18 @@ public:
 	//! Reads an array of characters from the input stream.
 	void read_raw(char* destination, unsigned int length);
 
+	//! Reads up to length bytes from the input stream in a single call and returns the number of bytes actually read.
+	//! The bytes that could not be read are zeroed.
+	std::uint64_t read_bulk(char* destination, std::uint64_t length);
+
+	//! Throws if a length prefix read from the file exceeds the maximum container size, in bytes.
+	//! Protects the readers against allocating absurd amounts of memory because of a corrupted file.
+	void check_container_size(std::uint64_t count, std::uint64_t element_size = 1) const;
+
+	//! Maximum size in bytes of a string or vector read from this file.
+	std::uint64_t max_container_size() const { return max_container_size_; }
+	void set_max_container_size(std::uint64_t size) { max_container_size_ = size; }
+
 	void seek(std::uint64_t pos)
 	{
 		eof_ = false;
@@ -42,6 +57,20 @@ public:
 
 	std::uint64_t pos() const { return in_file_.tellg(); }
 
+	//! Skips the specified number of bytes.
+	void skip(std::uint64_t length)
+	{
+		if (eof())
+			return;
+
+		// Seeking drops the read buffer, it is only worth it for big skips.
+		if (length < 16384)
+			in_file_.ignore(length);
+		else
+			in_file_.seekg(length, std::ios_base::cur);
+		check_eof();
+	}
+
 	//! Returns true if end of file is reached or an error occurred while reading.
 	bool eof() const { return eof_; }
 
@@ -60,6 +89,8 @@ private:
 	//! Set if the last read operation failed or end of file is reached
 	bool eof_;
 	bool opened_;
+
+	std::uint64_t max_container_size_;
 }; // class streamable_file
 
 inline void streamable_file::read_raw(char* destination, unsigned int length)
@@ -71,6 +102,18 @@ inline void streamable_file::read_raw(char* destination, unsigned int length)
 	}
 }
 
+inline std::uint64_t streamable_file::read_bulk(char* destination, std::uint64_t length)
+{
+	std::uint64_t read = 0;
+	if (not eof()) {
+		in_file_.read(destination, length);
+		read = in_file_.gcount();
+		check_eof();
+	}
+	std::memset(destination + read, 0, length - read);
+	return read;
+}
+
 template <typename T> void streamable_file::read_raw(T& value)
 {
 	read_raw(reinterpret_cast<char*>(&value), sizeof(value));
@@ -112,17 +155,49 @@ inline streamable_file& operator>>(streamable_file& in, std::string& data)
 	std::uint64_t length;
 	in >> length;
 
-	data.reserve(length);
+	data.clear();
+	if (in.eof())
+		return in;
+
+	in.check_container_size(length);
+
+	data.resize(length);
+	data.resize(in.read_bulk(&data[0], length));
+
+	// Strings are read as C strings: stop at the first terminator, if any.
+	auto terminator = data.find('\0');
+	if (terminator != std::string::npos)
+		data.resize(terminator);
+	return in;
+}
+
+//! Vectors of basic types are stored contiguously in the file, so they can be read in one go.
+//! Structures are not eligible, because their fields are stored without padding.
+template <typename T>
+struct is_bulk_readable
+    : std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value> {};
+
+template <typename T>
+typename std::enable_if<is_bulk_readable<T>::value, streamable_file&>::type
+operator>>(streamable_file& in, typename std::vector<T>& data)
+{
+	std::uint64_t size;
+	in >> size;
+	data.clear();
+	if (in.eof() || size == 0)
+		return in;
 
-	char received[length + 1];
-	in.read_raw(received, length);
-	received[length] = 0;
+	in.check_container_size(size, sizeof(T));
 
-	data = received;
+	data.resize(size);
+	std::uint64_t read = in.read_bulk(reinterpret_cast<char*>(data.data()), size * sizeof(T));
+	data.resize(read / sizeof(T));
 	return in;
 }
 
-template <typename T> streamable_file& operator>>(streamable_file& in, typename std::vector<T>& data)
+template <typename T>
+typename std::enable_if<!is_bulk_readable<T>::value, streamable_file&>::type
+operator>>(streamable_file& in, typename std::vector<T>& data)
 {
 	std::uint64_t size;
 	in >> size;
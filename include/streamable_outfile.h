@@ -20,17 +20,28 @@ public:
 	template <typename T> void write_raw(const T& value);
 
 	//! Writes an array of characters from the input stream.
-	void write_raw(const char* destination, unsigned int length);
+	void write_raw(const char* destination, std::uint64_t length);
+
+	//! Moves the write position, e.g. to fill a header once the rest of the file is known.
+	void seek(std::uint64_t pos) { out_file_.seekp(pos); }
+
+	std::uint64_t pos() { return out_file_.tellp(); }
 
 	//! Close the file and mark it eof.
 	void close();
 
+	//! Returns true if the file was successfully opened.
+	bool is_open() const { return out_file_.is_open(); }
+
+	//! Returns false if an error occurred while writing.
+	bool good() const { return out_file_.good(); }
+
 private:
 	//! Raw data
 	std::ofstream out_file_;
 }; // class streamable_outfile
 
-inline void streamable_outfile::write_raw(const char* destination, unsigned int length)
+inline void streamable_outfile::write_raw(const char* destination, std::uint64_t length)
 {
 	out_file_.write(destination, length);
 }
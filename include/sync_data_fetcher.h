@@ -0,0 +1,87 @@
+#pragma once
+
+#include "blob_pool.h"
+#include "sync_point.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Reads the data of many sync points from a data file at once.
+//!
+//! The data of a sync point is scattered in the data file, and reading it through a stream takes a seek and a few
+//! small reads. On a cold cache, reading the sync points one after the other then waits for the disk at each of
+//! them. The fetcher rather submits the reads of a whole batch of offsets together, queue_depth at a time, so that
+//! the disk serves them concurrently.
+//!
+//! The reads are submitted through io_uring when the kernel allows it, and by a pool of threads calling pread
+//! otherwise. Each offset is first read in a fixed size chunk. The dumps that do not fit are read in a next round,
+//! directly into their own buffer.
+//!
+//! See sync_file::set_data_fetcher to read the data of a sync file this way. A fetcher can be shared by several sync
+//! files, and used from several threads: their fetches are serialized, each one keeping the whole queue depth.
+class sync_data_fetcher {
+public:
+	enum class backend {
+		//! io_uring if available, the thread pool otherwise.
+		automatic,
+		io_uring,
+		thread_pool,
+	};
+
+	//! Opens the specified data file. Defaults to 64 reads in flight.
+	//! Throws if the io_uring backend is requested and not available.
+	explicit sync_data_fetcher(const std::string& data_file_name, unsigned queue_depth = 64,
+	                           backend requested = backend::automatic);
+	~sync_data_fetcher();
+
+	sync_data_fetcher(const sync_data_fetcher&) = delete;
+	sync_data_fetcher& operator=(const sync_data_fetcher&) = delete;
+
+	//! Returns true if the data file was opened and has the right magic number.
+	bool is_valid() const { return fd_ >= 0; }
+
+	//! The backend actually used.
+	backend active_backend() const { return backend_; }
+
+	unsigned queue_depth() const { return queue_depth_; }
+
+	//! Reads the data at each of the specified offsets, as sync_file would. Each dump is interned in the specified
+	//! pool, if any. Throws if the data file cannot be read.
+	std::vector<std::vector<sync_point_data>> fetch(const std::vector<std::uint32_t>& offsets,
+	                                                blob_pool* pool = nullptr);
+
+private:
+	//! Read of the buffer from offset, of which the first filled bytes are already known.
+	struct request {
+		std::uint64_t offset;
+		std::vector<std::uint8_t> buffer;
+		std::uint64_t filled;
+
+		//! Number of bytes of the buffer known once read, or -errno.
+		std::int64_t result;
+	};
+
+	struct uring;
+	struct pread_pool;
+
+	//! Reads the buffer of each request from its offset.
+	void read(std::vector<request>& requests);
+
+	//! The backends handle a single batch at a time.
+	std::mutex mutex_;
+
+	int fd_;
+	unsigned queue_depth_;
+	backend backend_;
+
+	std::unique_ptr<uring> uring_;
+	std::unique_ptr<pread_pool> pool_;
+}; // class sync_data_fetcher
+}
+} // namespace reven::vmghost
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "file_stamp.h"
+#include "streamable_file.h"
+#include "sync_point.h"
+
+#include <string>
+#include <vector>
+
+#define SYNC_DATA_INDEX_MAGIC 0x61636e79734e5652
+#define SYNC_DATA_INDEX_VERSION 0
+
+namespace reven {
+namespace vmghost {
+
+//! Index of the memory dumps of a sync file by the pages they cover.
+//!
+//! Answers "which sync points dumped this address" without reading the dumps: the index is built from the sync
+//! records and the headers of the dumps in the data file only. Logical and physical dumps are indexed in separate
+//! address spaces, named by their sync_point_data_type. A dump is indexed once for every page it covers.
+//!
+//! The index is stored next to the data file, and is only used if neither the sync file nor the data file changed
+//! since.
+class sync_data_index {
+public:
+	static constexpr unsigned page_shift = 12;
+
+	struct entry {
+		//! A sync_point_data_type.
+		std::uint64_t space;
+
+		std::uint64_t page;
+
+		//! Position of the sync point in the sync file, see sync_file::advance_to.
+		std::uint64_t position;
+
+		//! Offset of the dump in the data file, see read_dump.
+		std::uint64_t data_offset;
+
+		//! Range of the dump.
+		std::uint64_t address;
+		std::uint64_t length;
+	};
+
+	//! Name of the index file of the specified data file.
+	static std::string index_file_name(const std::string& data_file_name);
+
+	//! Reads the dump at the specified offset of the data file. Returns false if there is no dump there.
+	static bool read_dump(streamable_file& data_file, std::uint64_t data_offset, sync_point_data& dump);
+
+	//! Indexes the dumps of the specified files. Returns false if a file cannot be read.
+	bool build(const std::string& sync_file_name, const std::string& data_file_name);
+
+	//! Loads the index of the specified files. Returns false if there is no index, if it is out of date,
+	//! or if the file is not an index.
+	bool load(const std::string& sync_file_name, const std::string& data_file_name);
+
+	//! Writes the index next to the data file it was built from. Returns false on error.
+	bool save() const;
+
+	//! Loads the index of the specified files, building and saving it if necessary.
+	bool load_or_build(const std::string& sync_file_name, const std::string& data_file_name);
+
+	//! All the (page, dump) pairs, sorted by space, page, then position.
+	const std::vector<entry>& entries() const { return entries_; }
+
+	//! Returns the dumps of the specified space that overlap [address, address + length), once each, sorted by
+	//! position then by offset in the data file. The page member of the results is the first page of the range
+	//! covered by the dump.
+	std::vector<entry> query(sync_point_data_type space, std::uint64_t address, std::uint64_t length) const;
+
+private:
+	std::string data_file_name_;
+	file_stamp data_stamp_;
+	std::string sync_file_name_;
+	file_stamp sync_stamp_;
+
+	std::vector<entry> entries_;
+}; // class sync_data_index
+}
+} // namespace reven::vmghost
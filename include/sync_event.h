@@ -11,7 +11,19 @@ namespace vmghost {
 
 struct sync_event
 {
+	//! The general purpose and control registers, from rax to cr4, are laid out as an array that can be indexed, see
+	//! register_value. The FPU registers follow them in the masks returned by differing_registers.
 	struct context {
+		static constexpr unsigned register_count = 20;
+
+		//! Bits of the FPU registers in the masks returned by differing_registers.
+		static constexpr std::uint32_t fpu_sw_bit = 1u << register_count;
+		static constexpr std::uint32_t fpu_cw_bit = 1u << (register_count + 1);
+		static constexpr std::uint32_t fpu_tags_bit = 1u << (register_count + 2);
+
+		//! Mask of the registers, from rax to cr4.
+		static constexpr std::uint32_t registers_mask = fpu_sw_bit - 1;
+
 		std::uint64_t rax = 0;
 		std::uint64_t rbx = 0;
 		std::uint64_t rcx = 0;
@@ -39,7 +51,17 @@ struct sync_event
 		//! The TSC is always part of the context as an input value from VBox, do not check against it.
 		std::uint64_t tsc = 0;
 
-		bool are_values_equivalent(const context& other) const; //! Ignores TSC
+		//! Name of the register at the specified index, from "RAX" to "CR4".
+		static const char* register_name(unsigned index);
+
+		std::uint64_t register_value(unsigned index) const;
+		void set_register_value(unsigned index, std::uint64_t value);
+
+		//! Returns the mask of the registers whose value differs in other: bit i for the register at index i, then
+		//! the FPU bits. Ignores TSC.
+		std::uint32_t differing_registers(const context& other) const;
+
+		bool are_values_equivalent(const context& other) const; //! Ignores TSC and the FPU registers
 	};
 
 	//! Position inside the file, in frames
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "spsc_ring.h"
+#include "sync_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace reven {
+namespace vmghost {
+
+//! Reads the events of a sync file on a background thread.
+//!
+//! The thread reads the sync points and their memory dumps, and aggregates them into events (see
+//! sync_file::current_event) ahead of the consumer, into a ring of capacity events. Popping an event that is ready
+//! does not lock nor make a system call, and the memory used is bounded by the capacity of the ring.
+//!
+//! The events are the ones of the usual loop on the sync file: while (file.next().valid()) file.current_event(),
+//! except for its end. The reading stops at the end of the file, where next may keep returning the last sync point,
+//! e.g. of a truncated file, and the usual loop repeat the last event forever. It also stops before the first event
+//! that is not valid, which the usual loop would return. Otherwise, it stops at the first error, which next then
+//! throws in the consumer thread.
+//!
+//! The prefetcher has a single consumer: its functions must all be called from the same thread.
+class sync_event_prefetcher {
+public:
+	//! Defaults to 64 events read ahead.
+	//! Dumps are interned in the specified pool, if any (see sync_file::set_blob_pool).
+	sync_event_prefetcher(const std::string& file_name, const std::string& data_file_name,
+	                      std::size_t capacity = 64, std::shared_ptr<blob_pool> pool = nullptr);
+	~sync_event_prefetcher();
+
+	sync_event_prefetcher(const sync_event_prefetcher&) = delete;
+	sync_event_prefetcher& operator=(const sync_event_prefetcher&) = delete;
+
+	//! Returns true if there is a scenario file.
+	bool is_valid() const { return valid_; }
+
+	//! Next event, nullptr at the end of the file. The event stays valid until the next call.
+	//! Rethrows the error met by the background thread when reading the event.
+	const sync_event* next();
+
+	//! Restarts the reading at the specified position (see sync_file::advance_to). The next event is then the
+	//! current event of the file at that position, or the first event for position 0. The events read ahead are
+	//! dropped.
+	void advance_to(std::uint64_t position);
+
+	//! Number of events read ahead and not popped yet, counting the end of the file once it is reached.
+	std::size_t ready() const;
+
+private:
+	struct slot {
+		sync_event event;
+
+		//! Set instead of the event if reading it failed.
+		std::exception_ptr error;
+
+		//! Pushed once there is nothing left to read.
+		bool is_end = false;
+	};
+
+	//! Starts the thread, which first moves the file to the specified position if seek is set.
+	void start(bool seek, std::uint64_t position);
+
+	//! Stops the thread and drops the events read ahead.
+	void stop();
+
+	void produce(bool seek, std::uint64_t position);
+
+	//! Producer: pushes the event, waiting for a free slot. Returns false if the thread was stopped meanwhile.
+	bool push(const sync_event* event, std::exception_ptr error);
+
+	//! Waits until ready returns true, going to sleep after a while.
+	template <typename F> void wait(std::atomic<bool>& waiting, F ready);
+
+	//! Wakes up the other side if it is waiting.
+	void notify(std::atomic<bool>& waiting);
+
+	sync_file file_;
+	bool valid_;
+
+	spsc_ring<slot> ring_;
+
+	//! Slot returned by the last call to next, released by the next call.
+	bool holding_front_;
+
+	//! Set once the end, or an error, was popped.
+	bool ended_;
+
+	std::thread thread_;
+	std::atomic<bool> stopping_;
+
+	//! Threads that went to sleep for the ring to change. Waiting is only needed when the ring is empty or full,
+	//! the threads spin for a while before.
+	std::mutex mutex_;
+	std::condition_variable changed_;
+	std::atomic<bool> consumer_waiting_;
+	std::atomic<bool> producer_waiting_;
+}; // class sync_event_prefetcher
+}
+} // namespace reven::vmghost
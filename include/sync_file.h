@@ -1,9 +1,14 @@
 #pragma once
 
+#include "blob_pool.h"
 #include "streamable_file.h"
+#include "sync_data_fetcher.h"
 #include "sync_point.h"
 #include "sync_event.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace reven {
 namespace vmghost {
 
@@ -50,6 +55,10 @@ public:
 	//! Read frame until we reach the specified position in the file.
 	void advance_to(std::uint64_t position);
 
+	//! Moves to the sync point at the specified position, without the event logic of advance_to: current() is then
+	//! the sync point at that position, and next() reads the one after it. Position 0 is before the first sync point.
+	void seek_point(std::uint64_t position);
+
 	//! Read frame until we reach the specified position in the file.
 	void seek_from_end(std::uint64_t position);
 
@@ -70,6 +79,26 @@ public:
 	//! Returns the number of sync_point in the file
 	std::uint64_t sync_point_count() const { return sync_point_count_; }
 
+	//! Interns the memory dumps read from now on into the specified pool, so that identical dumps share their buffer.
+	//! nullptr, the default, gives each dump its own buffer.
+	void set_blob_pool(std::shared_ptr<blob_pool> pool) { blob_pool_ = std::move(pool); }
+	const std::shared_ptr<blob_pool>& get_blob_pool() const { return blob_pool_; }
+
+	//! Reads the data of the sync points with the specified fetcher instead of the data file: the data of the next
+	//! batch_size sync points is fetched at once, when the data of a sync point is missing.
+	//! nullptr, the default, reads the data file one sync point at a time.
+	void set_data_fetcher(std::shared_ptr<sync_data_fetcher> fetcher, unsigned batch_size = 64)
+	{
+		data_fetcher_ = std::move(fetcher);
+		fetch_batch_size_ = std::max(batch_size, 1u);
+		fetched_data_.clear();
+	}
+	const std::shared_ptr<sync_data_fetcher>& get_data_fetcher() const { return data_fetcher_; }
+
+	//! Offset of the data of the current sync point in the data file, 0 if it has none.
+	//! Known even when the data file is not loaded, which allows to read the data separately.
+	std::uint32_t data_offset() const { return data_offset_; }
+
 private:
 	static void point_context_to_event(const sync_point& sp, sync_event::context& context);
 
@@ -78,6 +107,9 @@ private:
 
 	sync_event fetch_new_event();
 
+	//! Fetches the data of the sync points from the current one, see set_data_fetcher.
+	void fetch_data_batch();
+
 	//! File that contains the traces
 	streamable_file file_;
 
@@ -105,6 +137,17 @@ private:
 	// The number of sync_point in the file
 	std::uint64_t sync_point_count_;
 
+	// Offset of the data of the current sync point in the data file
+	std::uint32_t data_offset_;
+
+	// Pool of the memory dumps, if any
+	std::shared_ptr<blob_pool> blob_pool_;
+
+	// Fetcher of the data, if any, and the data of the last batch by offset
+	std::shared_ptr<sync_data_fetcher> data_fetcher_;
+	unsigned fetch_batch_size_;
+	std::unordered_map<std::uint32_t, std::vector<sync_point_data>> fetched_data_;
+
 }; // class sync_file
 }
 } // namespace reven::vmghost
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "shared_blob.h"
+
 #include <cstdint>
 #include <ostream>
 #include <vector>
@@ -90,7 +92,9 @@ struct sync_point_data
 {
 	sync_point_data_type type;
 	std::uint64_t offset;
-	std::vector<std::uint8_t> data;
+
+	//! Shared by the copies of the dump, e.g. in the events, see blob_pool.
+	shared_blob data;
 };
 
 std::ostream& operator<<(std::ostream& out, const sync_point_data& data);
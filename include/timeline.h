@@ -0,0 +1,86 @@
+#pragma once
+
+#include "hardware_file.h"
+#include "hardware_index.h"
+#include "sync_file.h"
+
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! An element of a timeline: either a sync event or a hardware access.
+struct timeline_item {
+	enum class kind {
+		none,
+		event,
+		access,
+	};
+
+	kind type = kind::none;
+
+	std::uint64_t tsc = 0;
+
+	//! Index of the hardware file the access comes from.
+	std::size_t source = 0;
+
+	//! Valid until the timeline moves, nullptr for hardware accesses.
+	const sync_event* event = nullptr;
+
+	//! Valid until the timeline moves, nullptr for sync events.
+	const hardware_access* access = nullptr;
+
+	bool is_event() const { return type == kind::event; }
+	bool is_access() const { return type == kind::access; }
+	bool valid() const { return type != kind::none; }
+};
+
+//! Reads the events of a sync file and the accesses of hardware files together, in TSC order.
+//!
+//! The TSC of an event is the TSC of the VM exit that started it, or of its VM enter if the VM exit is missing. When
+//! several items have the same TSC, events come first, then accesses in the order of their hardware files, then in
+//! file order.
+//!
+//! Only the next item of each source is read ahead, which is why each source has to be sorted by TSC on its own
+//! (see reorder_hardware).
+//!
+//! The timeline reads from the files it is given, which must outlive it and must not be moved by anyone else while
+//! it is in use.
+class timeline {
+public:
+	timeline(sync_file& sync, const std::vector<hardware_file*>& hardware);
+
+	//! Makes seek_tsc use the specified index for the specified hardware file. Only useful for version 0 files:
+	//! others are binary searched.
+	void set_index(std::size_t source, const hardware_index* index);
+
+	const timeline_item& current() const { return current_; }
+
+	const timeline_item& next();
+
+	//! Moves the timeline so that the next item is the first one whose TSC is greater or equal to tsc.
+	void seek_tsc(std::uint64_t tsc);
+
+	//! TSC of the specified event.
+	static std::uint64_t event_tsc(const sync_event& event);
+
+private:
+	//! Reads the next event into the head of the sync file.
+	void advance_sync();
+
+	//! Moves the sync file to the first event whose TSC is greater or equal to tsc.
+	void seek_sync(std::uint64_t tsc);
+
+	sync_file& sync_;
+	std::vector<hardware_file*> hardware_;
+	std::vector<const hardware_index*> indexes_;
+
+	//! Whether the head of each source has been read. The head of the sync file is its current event, and the head
+	//! of each hardware file is its current access.
+	bool sync_ready_;
+	std::vector<bool> hardware_ready_;
+
+	timeline_item current_;
+}; // class timeline
+}
+} // namespace reven::vmghost
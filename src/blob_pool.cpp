@@ -0,0 +1,113 @@
+#include <blob_pool.h>
+
+#include "content_hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace reven {
+namespace vmghost {
+
+blob_pool::blob_pool()
+  : purged_size_(0), interned_bytes_(0), stored_bytes_(0), interned_blobs_(0), stored_blobs_(0)
+{
+}
+
+shared_blob blob_pool::intern(std::vector<std::uint8_t>&& bytes)
+{
+	if (bytes.empty())
+		return shared_blob();
+
+	std::uint64_t hash = content_hash(bytes.data(), bytes.size());
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	++interned_blobs_;
+	interned_bytes_ += bytes.size();
+
+	auto range = buffers_.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		std::shared_ptr<const buffer> existing = it->second.lock();
+
+		if (existing && existing->size() == bytes.size() &&
+		    std::memcmp(existing->data(), bytes.data(), bytes.size()) == 0)
+			return shared_blob(std::move(existing));
+	}
+
+	++stored_blobs_;
+	stored_bytes_ += bytes.size();
+
+	auto stored = std::make_shared<const buffer>(std::move(bytes));
+	buffers_.emplace(hash, stored);
+
+	// Forget the freed buffers from time to time, so that the map follows the number of live buffers.
+	if (buffers_.size() >= 2 * purged_size_ + 1024)
+		purge();
+
+	return shared_blob(std::move(stored));
+}
+
+void blob_pool::purge()
+{
+	for (auto it = buffers_.begin(); it != buffers_.end();) {
+		if (it->second.expired())
+			it = buffers_.erase(it);
+		else
+			++it;
+	}
+	purged_size_ = buffers_.size();
+}
+
+std::uint64_t blob_pool::interned_bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return interned_bytes_;
+}
+
+std::uint64_t blob_pool::stored_bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stored_bytes_;
+}
+
+std::uint64_t blob_pool::interned_blobs() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return interned_blobs_;
+}
+
+std::uint64_t blob_pool::stored_blobs() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stored_blobs_;
+}
+
+double blob_pool::deduplication_ratio() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stored_bytes_ == 0 ? 1. : static_cast<double>(interned_bytes_) / stored_bytes_;
+}
+
+std::uint64_t blob_pool::live_bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	std::uint64_t bytes = 0;
+	for (const auto& entry : buffers_) {
+		if (auto live = entry.second.lock())
+			bytes += live->size();
+	}
+	return bytes;
+}
+
+std::uint64_t blob_pool::live_blobs() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return std::count_if(buffers_.begin(), buffers_.end(),
+	                     [](const std::pair<const std::uint64_t, std::weak_ptr<const buffer>>& entry) {
+		                     return not entry.second.expired();
+	                     });
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,104 @@
+#include <coalesced_hardware_file.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace reven {
+namespace vmghost {
+
+coalesced_hardware_file::coalesced_hardware_file()
+  : tsc_tolerance_(0), max_size_(64 * 1024), has_lookahead_(false), begin_(0), position_(0), source_position_(0)
+{
+}
+
+bool coalesced_hardware_file::load(const std::string& file_name)
+{
+	current_ = hardware_access();
+	has_lookahead_ = false;
+	position_ = 0;
+	source_position_ = 0;
+
+	return file_.load(file_name);
+}
+
+const hardware_access& coalesced_hardware_file::next()
+{
+	if (has_lookahead_) {
+		std::swap(current_, lookahead_);
+		has_lookahead_ = false;
+	} else {
+		current_ = file_.next();
+		if (current_.valid())
+			++source_position_;
+	}
+
+	if (not current_.valid())
+		return current_;
+
+	++position_;
+
+	if (not current_.is_write() || current_.is_mmio() || current_.is_port())
+		return current_;
+
+	begin_ = current_.physical_address;
+	data_.assign(current_.data.begin(), current_.data.end());
+
+	bool merged = false;
+
+	while (file_.next().valid()) {
+		const hardware_access& access = file_.current();
+		++source_position_;
+
+		if (not can_merge(access)) {
+			lookahead_ = access;
+			has_lookahead_ = true;
+			break;
+		}
+
+		merge(access);
+		merged = true;
+	}
+
+	if (merged) {
+		current_.physical_address = begin_;
+		current_.data.assign(data_.data(), data_.data() + data_.size());
+	}
+
+	return current_;
+}
+
+bool coalesced_hardware_file::can_merge(const hardware_access& access) const
+{
+	if (access.type != current_.type || access.device_id != current_.device_id ||
+	    access.device_instance != current_.device_instance)
+		return false;
+
+	if (access.tsc < current_.tsc || access.tsc - current_.tsc > tsc_tolerance_)
+		return false;
+
+	std::uint64_t end = begin_ + data_.size();
+	std::uint64_t access_end = access.physical_address + access.length();
+
+	// Contiguous or overlapping.
+	if (access.physical_address > end || access_end < begin_)
+		return false;
+
+	return std::max(end, access_end) - std::min(begin_, access.physical_address) <= max_size_;
+}
+
+void coalesced_hardware_file::merge(const hardware_access& access)
+{
+	std::uint64_t begin = std::min(begin_, access.physical_address);
+	std::uint64_t end = std::max(begin_ + data_.size(), access.physical_address + access.length());
+
+	if (begin < begin_)
+		data_.insert(data_.begin(), begin_ - begin, 0);
+	data_.resize(end - begin);
+
+	std::copy(access.data.begin(), access.data.end(), data_.begin() + (access.physical_address - begin));
+
+	begin_ = begin;
+	current_.tsc = access.tsc;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace reven {
+namespace vmghost {
+
+//! Fast non cryptographic hash of a byte buffer, to find identical buffers. Equal hashes must still be compared.
+inline std::uint64_t content_hash(const std::uint8_t* data, std::uint64_t length)
+{
+	std::uint64_t hash = 0xcbf29ce484222325ull ^ length;
+
+	std::uint64_t i = 0;
+	for (; i + 8 <= length; i += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+
+		hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+		hash ^= hash >> 29;
+	}
+	for (; i < length; ++i) {
+		hash = (hash ^ data[i]) * 0x100000001b3ull;
+	}
+
+	hash ^= hash >> 32;
+	return hash * 0xd6e8feb86659fd93ull;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,106 @@
+#include <device_resolver.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace reven {
+namespace vmghost {
+
+device_resolver::device_resolver() : targets_(1), ports_(0x10000, 0)
+{
+}
+
+void device_resolver::build(const std::map<std::uint64_t, device>& devices)
+{
+	targets_.assign(1, device_match());
+	std::fill(ports_.begin(), ports_.end(), 0);
+	range_starts_.clear();
+	range_ends_.clear();
+	range_targets_.clear();
+
+	auto target_index = [this](const device& dev, std::uint32_t instance) {
+		for (std::uint32_t i = 1; i < targets_.size(); ++i) {
+			if (targets_[i].dev == &dev && targets_[i].instance == instance)
+				return i;
+		}
+		device_match match;
+		match.dev = &dev;
+		match.instance = instance;
+		targets_.push_back(match);
+		return static_cast<std::uint32_t>(targets_.size() - 1);
+	};
+
+	// start, end, target
+	std::vector<std::tuple<std::uint64_t, std::uint64_t, std::uint32_t>> ranges;
+
+	for (const auto& pair : devices) {
+		const device& dev = pair.second;
+
+		for (const port_range& range : dev.port_ranges) {
+			std::uint32_t target = target_index(dev, range.instance);
+			std::uint32_t end = std::min<std::uint32_t>(std::uint32_t(range.port) + range.length, 0x10000);
+			for (std::uint32_t port = range.port; port < end; ++port) {
+				if (ports_[port] == 0)
+					ports_[port] = target;
+			}
+		}
+
+		for (const memory_range& range : dev.memory_ranges) {
+			if (range.length == 0)
+				continue;
+			ranges.emplace_back(range.physical_address, range.physical_address + range.length,
+			                    target_index(dev, range.instance));
+		}
+	}
+
+	std::stable_sort(ranges.begin(), ranges.end(), [](const decltype(ranges)::value_type& lhs,
+	                                                  const decltype(ranges)::value_type& rhs) {
+		return std::get<0>(lhs) < std::get<0>(rhs);
+	});
+
+	for (const auto& range : ranges) {
+		std::uint64_t start = std::get<0>(range);
+		std::uint64_t end = std::get<1>(range);
+
+		// Overlapping ranges: only keep what is not already covered.
+		if (not range_ends_.empty())
+			start = std::max(start, range_ends_.back());
+		if (start >= end)
+			continue;
+
+		range_starts_.push_back(start);
+		range_ends_.push_back(end);
+		range_targets_.push_back(std::get<2>(range));
+	}
+}
+
+device_match device_resolver::resolve_address(std::uint64_t physical_address) const
+{
+	if (range_starts_.empty())
+		return targets_[0];
+
+	// Branchless binary search for the last range starting at or before the address.
+	const std::uint64_t* base = range_starts_.data();
+	std::size_t count = range_starts_.size();
+	while (count > 1) {
+		std::size_t half = count / 2;
+		base = (base[half] <= physical_address) ? base + half : base;
+		count -= half;
+	}
+
+	std::size_t index = base - range_starts_.data();
+	bool inside = range_starts_[index] <= physical_address && physical_address < range_ends_[index];
+
+	return targets_[inside ? range_targets_[index] : 0];
+}
+
+void device_resolver::resolve(const hardware_batch& batch, std::vector<device_match>& matches) const
+{
+	matches.resize(batch.size());
+
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		matches[i] = resolve(batch[i]);
+	}
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,248 @@
+#include <event_table.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+using context = sync_event::context;
+
+enum event_flags : std::uint8_t {
+	valid = 1,
+	first_event_context_unknown = 2,
+	last_event = 4,
+	interrupt = 8,
+	instruction_emulation = 16,
+
+	//! The interrupt fields are stored, which they are if any of them is set, even without an interrupt.
+	interrupt_fields = 32,
+};
+
+void put_varint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+	while (value >= 0x80) {
+		out.push_back(static_cast<std::uint8_t>(value) | 0x80);
+		value >>= 7;
+	}
+	out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t get_varint(const std::uint8_t*& in)
+{
+	std::uint64_t value = 0;
+	unsigned shift = 0;
+
+	while (*in & 0x80) {
+		value |= static_cast<std::uint64_t>(*in++ & 0x7f) << shift;
+		shift += 7;
+	}
+	return value | static_cast<std::uint64_t>(*in++) << shift;
+}
+
+//! Signed differences as small unsigned values: 0, -1, 1, -2...
+void put_delta(std::vector<std::uint8_t>& out, std::uint64_t value, std::uint64_t reference)
+{
+	std::uint64_t delta = value - reference;
+	put_varint(out, (delta << 1) ^ (delta >> 63 ? UINT64_MAX : 0));
+}
+
+std::uint64_t get_delta(const std::uint8_t*& in, std::uint64_t reference)
+{
+	std::uint64_t zigzag = get_varint(in);
+	return reference + ((zigzag >> 1) ^ (zigzag & 1 ? UINT64_MAX : 0));
+}
+
+void put_context(std::vector<std::uint8_t>& out, const context& c, const context& reference)
+{
+	std::uint32_t changed = c.differing_registers(reference);
+	put_varint(out, changed);
+
+	for (unsigned i = 0; i < context::register_count; ++i) {
+		if (changed & (1u << i))
+			put_varint(out, c.register_value(i) ^ reference.register_value(i));
+	}
+
+	if (changed & context::fpu_sw_bit)
+		put_varint(out, c.fpu_sw);
+	if (changed & context::fpu_cw_bit)
+		put_varint(out, c.fpu_cw);
+	if (changed & context::fpu_tags_bit)
+		out.push_back(c.fpu_tags);
+
+	put_delta(out, c.tsc, reference.tsc);
+}
+
+void get_context(const std::uint8_t*& in, context& c, const context& reference)
+{
+	c = reference;
+
+	std::uint32_t changed = static_cast<std::uint32_t>(get_varint(in));
+
+	for (unsigned i = 0; i < context::register_count; ++i) {
+		if (changed & (1u << i))
+			c.set_register_value(i, reference.register_value(i) ^ get_varint(in));
+	}
+
+	if (changed & context::fpu_sw_bit)
+		c.fpu_sw = static_cast<std::uint16_t>(get_varint(in));
+	if (changed & context::fpu_cw_bit)
+		c.fpu_cw = static_cast<std::uint16_t>(get_varint(in));
+	if (changed & context::fpu_tags_bit)
+		c.fpu_tags = *in++;
+
+	c.tsc = get_delta(in, reference.tsc);
+}
+}
+
+event_table::reader::reader(const event_table& table)
+  : table_(&table), next_index_(0), next_offset_(0), next_dump_(0)
+{
+}
+
+const sync_event& event_table::reader::get(std::uint64_t index)
+{
+	if (index >= table_->size_) {
+		std::stringstream error_msg;
+
+		error_msg << "Event #" << std::dec << index << " is out of a table of " << table_->size_ << " events";
+
+		throw std::out_of_range(error_msg.str());
+	}
+
+	// Restart from the keyframe before, unless the event is after the current one and before the next keyframe.
+	if (index < next_index_ || index / table_->keyframe_interval_ != next_index_ / table_->keyframe_interval_) {
+		const keyframe& start = table_->keyframes_[index / table_->keyframe_interval_];
+
+		next_index_ = index - index % table_->keyframe_interval_;
+		next_offset_ = start.offset;
+		next_dump_ = start.first_dump;
+	}
+
+	while (next_index_ <= index) {
+		next_offset_ = table_->decode(next_offset_, next_dump_, next_index_ % table_->keyframe_interval_ == 0, event_);
+		++next_index_;
+	}
+
+	return event_;
+}
+
+event_table::event_table(std::uint64_t keyframe_interval)
+  : keyframe_interval_(std::max<std::uint64_t>(keyframe_interval, 1)), size_(0)
+{
+}
+
+void event_table::push_back(const sync_event& event)
+{
+	if (size_ % keyframe_interval_ == 0) {
+		keyframes_.push_back({bytes_.size(), dumps_.size()});
+		last_ = sync_event();
+	}
+
+	std::uint8_t flags = 0;
+	if (event.is_valid)
+		flags |= event_flags::valid;
+	if (event.is_first_event_context_unknown)
+		flags |= event_flags::first_event_context_unknown;
+	if (event.is_last_event)
+		flags |= event_flags::last_event;
+	if (event.has_interrupt)
+		flags |= event_flags::interrupt;
+	if (event.is_instruction_emulation)
+		flags |= event_flags::instruction_emulation;
+	if (event.has_interrupt || event.interrupt_vector != 0 || event.interrupt_rip != 0 || event.fault_error_code != 0)
+		flags |= event_flags::interrupt_fields;
+
+	bytes_.push_back(flags);
+	put_varint(bytes_, static_cast<std::uint64_t>(event.start_reason));
+	put_delta(bytes_, event.position, last_.position);
+	put_delta(bytes_, event.start_rip, last_.start_rip);
+	put_varint(bytes_, event.rflags ^ last_.rflags);
+
+	if (flags & event_flags::interrupt_fields) {
+		bytes_.push_back(event.interrupt_vector);
+		put_delta(bytes_, event.interrupt_rip, event.start_rip);
+		put_varint(bytes_, event.fault_error_code);
+	}
+
+	put_context(bytes_, event.start_context, last_.new_context);
+	put_context(bytes_, event.new_context, event.start_context);
+
+	put_varint(bytes_, event.data.size());
+	dumps_.insert(dumps_.end(), event.data.begin(), event.data.end());
+
+	// Only the fields used as references are kept.
+	last_.position = event.position;
+	last_.start_rip = event.start_rip;
+	last_.rflags = event.rflags;
+	last_.new_context = event.new_context;
+
+	++size_;
+}
+
+sync_event event_table::at(std::uint64_t index) const
+{
+	reader events(*this);
+	return events.get(index);
+}
+
+std::uint64_t event_table::memory_usage() const
+{
+	return sizeof(*this) + bytes_.capacity() + keyframes_.capacity() * sizeof(keyframe) +
+	       dumps_.capacity() * sizeof(sync_point_data);
+}
+
+void event_table::clear()
+{
+	bytes_.clear();
+	keyframes_.clear();
+	dumps_.clear();
+	size_ = 0;
+	last_ = sync_event();
+}
+
+std::uint64_t event_table::decode(std::uint64_t offset, std::uint64_t& dump, bool is_keyframe, sync_event& event) const
+{
+	if (is_keyframe)
+		event = sync_event();
+
+	const std::uint8_t* begin = bytes_.data() + offset;
+	const std::uint8_t* in = begin;
+
+	std::uint8_t flags = *in++;
+	event.is_valid = flags & event_flags::valid;
+	event.is_first_event_context_unknown = flags & event_flags::first_event_context_unknown;
+	event.is_last_event = flags & event_flags::last_event;
+	event.has_interrupt = flags & event_flags::interrupt;
+	event.is_instruction_emulation = flags & event_flags::instruction_emulation;
+
+	event.start_reason = static_cast<sync_point_type>(get_varint(in));
+	event.position = get_delta(in, event.position);
+	event.start_rip = get_delta(in, event.start_rip);
+	event.rflags ^= get_varint(in);
+
+	if (flags & event_flags::interrupt_fields) {
+		event.interrupt_vector = *in++;
+		event.interrupt_rip = get_delta(in, event.start_rip);
+		event.fault_error_code = static_cast<std::uint32_t>(get_varint(in));
+	} else {
+		event.interrupt_vector = 0;
+		event.interrupt_rip = 0;
+		event.fault_error_code = 0;
+	}
+
+	context start_reference = event.new_context;
+	get_context(in, event.start_context, start_reference);
+	get_context(in, event.new_context, event.start_context);
+
+	std::uint64_t dump_count = get_varint(in);
+	event.data.assign(dumps_.begin() + dump, dumps_.begin() + dump + dump_count);
+	dump += dump_count;
+
+	return offset + (in - begin);
+}
+}
+} // namespace reven::vmghost
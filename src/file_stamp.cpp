@@ -0,0 +1,20 @@
+#include <file_stamp.h>
+
+#include <sys/stat.h>
+
+namespace reven {
+namespace vmghost {
+
+bool file_stamp::of(const std::string& file_name, file_stamp& stamp)
+{
+	struct stat st;
+
+	if (::stat(file_name.c_str(), &st) != 0)
+		return false;
+
+	stamp.size = st.st_size;
+	stamp.modification_time = static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,17 @@
+#include <hardware_batch.h>
+
+namespace reven {
+namespace vmghost {
+
+hardware_access hardware_batch::access(std::size_t index) const
+{
+	hardware_access result;
+	const entry& e = entries_[index];
+
+	static_cast<hardware_access_header&>(result) = e;
+	result.data.assign(data(index), data(index) + e.length);
+
+	return result;
+}
+}
+} // namespace reven::vmghost
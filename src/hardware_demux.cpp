@@ -0,0 +1,166 @@
+#include <hardware_demux.h>
+#include <hardware_outfile.h>
+#include <mapped_hardware_file.h>
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+
+namespace reven {
+namespace vmghost {
+
+static streamable_file& operator>>(streamable_file& in, hardware_stream& stream)
+{
+	in >> stream.device_id >> stream.device_instance >> stream.device_name >> stream.file_name >> stream.count >>
+	    stream.first_tsc >> stream.last_tsc;
+	return in;
+}
+
+static streamable_outfile& operator<<(streamable_outfile& out, const hardware_stream& stream)
+{
+	out << stream.device_id << stream.device_instance << stream.device_name << stream.file_name << stream.count
+	    << stream.first_tsc << stream.last_tsc;
+	return out;
+}
+
+std::string hardware_manifest::manifest_file_name(const std::string& prefix)
+{
+	return prefix + ".manifest";
+}
+
+bool hardware_manifest::load(const std::string& file_name)
+{
+	streams_.clear();
+
+	streamable_file file;
+	file.load(file_name);
+
+	if (file.eof() || !file.is_open())
+		return false;
+
+	std::uint64_t magic;
+	std::uint32_t version;
+
+	file >> magic >> version;
+
+	if (file.eof()) {
+		return false;
+	} else if (magic != HARDWARE_MANIFEST_MAGIC) {
+		std::stringstream error_msg;
+
+		error_msg << "Magic number should be "
+		          << std::showbase << std::hex << HARDWARE_MANIFEST_MAGIC
+		          << " but is actually "
+		          << std::showbase <<  std::hex << magic;
+
+		throw std::runtime_error(error_msg.str());
+	} else if (version > HARDWARE_MANIFEST_VERSION) {
+		std::stringstream error_msg;
+
+		error_msg << "This version number is not handled: "
+		          << std::dec << version
+		          << ", expecting version "
+		          << std::dec << HARDWARE_MANIFEST_VERSION;
+
+		throw std::runtime_error(error_msg.str());
+	}
+
+	file >> source_ >> source_stamp_.size >> source_stamp_.modification_time >> streams_;
+
+	return not file.eof();
+}
+
+bool hardware_manifest::save(const std::string& file_name) const
+{
+	streamable_outfile out;
+	out.open(file_name);
+
+	if (not out.is_open())
+		return false;
+
+	std::uint64_t magic = HARDWARE_MANIFEST_MAGIC;
+	std::uint32_t version = HARDWARE_MANIFEST_VERSION;
+
+	out << magic << version << source_ << source_stamp_.size << source_stamp_.modification_time << streams_;
+	out.close();
+
+	return out.good();
+}
+
+bool hardware_manifest::is_up_to_date() const
+{
+	file_stamp stamp;
+	return file_stamp::of(source_, stamp) && stamp == source_stamp_;
+}
+
+const hardware_stream* hardware_manifest::find(std::uint64_t device_id, std::uint32_t device_instance) const
+{
+	for (const auto& stream : streams_) {
+		if (stream.device_id == device_id && stream.device_instance == device_instance)
+			return &stream;
+	}
+	return nullptr;
+}
+
+bool split_hardware_file(const std::string& source, const std::string& prefix, const io_file* io,
+                         hardware_manifest& manifest)
+{
+	manifest.streams_.clear();
+	manifest.source_ = source;
+
+	if (not file_stamp::of(source, manifest.source_stamp_))
+		return false;
+
+	mapped_hardware_file file;
+	if (not file.load(source))
+		return false;
+
+	std::map<std::pair<std::uint64_t, std::uint32_t>, std::size_t> stream_indexes;
+	std::vector<std::unique_ptr<hardware_outfile>> outputs;
+
+	while (file.next().valid()) {
+		const hardware_access_view& access = file.current();
+
+		auto key = std::make_pair(access.device_id, access.device_instance);
+		auto it = stream_indexes.find(key);
+
+		if (it == stream_indexes.end()) {
+			hardware_stream stream;
+			stream.device_id = access.device_id;
+			stream.device_instance = access.device_instance;
+			stream.file_name = prefix + "." + std::to_string(access.device_id) + "-" +
+			                   std::to_string(access.device_instance);
+			stream.count = 0;
+			stream.first_tsc = access.tsc;
+			stream.last_tsc = access.tsc;
+
+			if (io != nullptr) {
+				auto dev = io->devices().find(access.device_id);
+				if (dev != io->devices().end())
+					stream.device_name = dev->second.name;
+			}
+
+			outputs.emplace_back(new hardware_outfile);
+			if (not outputs.back()->open(stream.file_name))
+				return false;
+
+			it = stream_indexes.emplace(key, manifest.streams_.size()).first;
+			manifest.streams_.push_back(stream);
+		}
+
+		hardware_stream& stream = manifest.streams_[it->second];
+		outputs[it->second]->write(access);
+		++stream.count;
+		stream.last_tsc = access.tsc;
+	}
+
+	for (auto& output : outputs) {
+		if (not output->close())
+			return false;
+	}
+
+	return manifest.save(hardware_manifest::manifest_file_name(prefix));
+}
+}
+} // namespace reven::vmghost
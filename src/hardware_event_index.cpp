@@ -0,0 +1,144 @@
+#include <hardware_event_index.h>
+#include <hardware_file.h>
+#include <index_header.h>
+#include <sync_file.h>
+#include <timeline.h>
+
+#include <iomanip>
+#include <sstream>
+
+namespace reven {
+namespace vmghost {
+
+constexpr std::uint64_t hardware_event_index::no_event;
+
+std::string hardware_event_index::index_file_name(const std::string& hardware_file_name)
+{
+	return hardware_file_name + ".events";
+}
+
+bool hardware_event_index::build(const std::string& hardware_file_name, const std::string& sync_file_name)
+{
+	access_events_.clear();
+	event_first_accesses_.assign(1, 0);
+	event_positions_.clear();
+	event_tscs_.clear();
+	hardware_file_name_ = hardware_file_name;
+	sync_file_name_ = sync_file_name;
+
+	if (not file_stamp::of(hardware_file_name, hardware_stamp_) || not file_stamp::of(sync_file_name, sync_stamp_))
+		return false;
+
+	sync_file sync;
+	if (not sync.load(sync_file_name, ""))
+		return false;
+
+	hardware_file file;
+	if (not file.load(hardware_file_name))
+		return false;
+
+	timeline merged(sync, {&file});
+	std::uint64_t last_tsc = 0;
+
+	while (merged.next().valid()) {
+		const timeline_item& item = merged.current();
+
+		if (item.is_event()) {
+			event_first_accesses_.push_back(access_events_.size());
+			event_positions_.push_back(item.event->position);
+			event_tscs_.push_back(item.tsc);
+			continue;
+		}
+
+		if (item.tsc < last_tsc) {
+			std::stringstream error_msg;
+
+			error_msg << "Hardware access $" << std::dec << access_events_.size()
+			          << " is out of order, the file must be reordered";
+
+			throw std::runtime_error(error_msg.str());
+		}
+		last_tsc = item.tsc;
+
+		access_events_.push_back(event_positions_.size());
+	}
+
+	event_first_accesses_.push_back(access_events_.size());
+
+	return true;
+}
+
+bool hardware_event_index::load(const std::string& hardware_file_name, const std::string& sync_file_name)
+{
+	access_events_.clear();
+	event_first_accesses_.clear();
+	event_positions_.clear();
+	event_tscs_.clear();
+	hardware_file_name_ = hardware_file_name;
+	sync_file_name_ = sync_file_name;
+
+	file_stamp current_hardware_stamp;
+	file_stamp current_sync_stamp;
+	if (not file_stamp::of(hardware_file_name, current_hardware_stamp) ||
+	    not file_stamp::of(sync_file_name, current_sync_stamp))
+		return false;
+
+	streamable_file file;
+	file.load(index_file_name(hardware_file_name));
+
+	// Indexed against another sync file.
+	if (not read_index_header(file, HARDWARE_EVENT_INDEX_MAGIC, HARDWARE_EVENT_INDEX_VERSION,
+	                          current_hardware_stamp) ||
+	    not read_indexed_file(file, sync_file_name, current_sync_stamp))
+		return false;
+
+	hardware_stamp_ = current_hardware_stamp;
+	sync_stamp_ = current_sync_stamp;
+
+	if (not read_index_vector(file, access_events_) || not read_index_vector(file, event_first_accesses_) ||
+	    not read_index_vector(file, event_positions_) || not read_index_vector(file, event_tscs_) ||
+	    event_first_accesses_.size() != event_positions_.size() + 2) {
+		access_events_.clear();
+		event_first_accesses_.clear();
+		event_positions_.clear();
+		event_tscs_.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool hardware_event_index::save() const
+{
+	streamable_outfile out;
+	out.open(index_file_name(hardware_file_name_));
+
+	if (not out.is_open())
+		return false;
+
+	write_index_header(out, HARDWARE_EVENT_INDEX_MAGIC, HARDWARE_EVENT_INDEX_VERSION, hardware_stamp_);
+	write_indexed_file(out, sync_file_name_, sync_stamp_);
+
+	write_index_vector(out, access_events_);
+	write_index_vector(out, event_first_accesses_);
+	write_index_vector(out, event_positions_);
+	write_index_vector(out, event_tscs_);
+	out.close();
+
+	return out.good();
+}
+
+bool hardware_event_index::load_or_build(const std::string& hardware_file_name, const std::string& sync_file_name)
+{
+	if (load(hardware_file_name, sync_file_name))
+		return true;
+
+	if (not build(hardware_file_name, sync_file_name))
+		return false;
+
+	// The index is still usable if it cannot be saved, e.g. in a read-only directory.
+	save();
+	return true;
+}
+}
+} // namespace reven::vmghost
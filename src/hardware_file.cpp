@@ -6,7 +6,12 @@
 namespace reven {
 namespace vmghost {
 
-hardware_file::hardware_file() : last_read_position_(0), position_(0)
+constexpr std::uint64_t hardware_file::v1_header_size;
+constexpr std::uint64_t hardware_file::v1_entry_size;
+
+hardware_file::hardware_file()
+  : version_(0), record_count_(0), table_offset_(0), heap_offset_(0), record_index_(0), data_offset_(0),
+    heap_position_(0), threads_(1), last_read_position_(0), position_(0)
 {
 }
 
@@ -20,9 +25,8 @@ bool hardware_file::load(const std::string& file_path)
 	}
 
 	std::uint64_t magic;
-	std::uint32_t version;
 
-	file_ >> magic >> version;
+	file_ >> magic >> version_;
 
 	if (file_.eof()) {
 		file_.close();
@@ -38,6 +42,45 @@ bool hardware_file::load(const std::string& file_path)
 		          << std::showbase <<  std::hex << magic;
 
 		throw std::runtime_error(error_msg.str());
+	} else if (version_ > HARDWARE_FILE_VERSION) {
+		file_.close();
+
+		std::stringstream error_msg;
+
+		error_msg << "This version number is not handled: "
+		          << std::dec << version_
+		          << ", expecting version "
+		          << std::dec << HARDWARE_FILE_VERSION;
+
+		throw std::runtime_error(error_msg.str());
+	}
+
+	if (version_ >= 1) {
+		file_ >> record_count_ >> table_offset_ >> heap_offset_;
+		bool truncated = file_.eof();
+
+		file_.seek_from_end(0);
+		std::uint64_t file_size = file_.pos();
+
+		if (truncated || table_offset_ > file_size || (file_size - table_offset_) / v1_entry_size < record_count_) {
+			file_.close();
+			throw std::runtime_error("Malformed hardware file: the metadata table is truncated");
+		}
+
+		if (version_ >= 2) {
+			payloads_ = payload_store::open(payload_store::store_file_name(file_path));
+			if (not payloads_) {
+				file_.close();
+				return false;
+			}
+		} else {
+			heap_file_.load(file_path);
+			heap_file_.seek(heap_offset_);
+			heap_position_ = heap_offset_;
+		}
+
+		file_.seek(table_offset_);
+		record_index_ = 0;
 	}
 
 	last_read_position_ = file_.pos();
@@ -49,7 +92,18 @@ const hardware_access& hardware_file::next()
 {
 	last_read_position_ = file_.pos();
 
-	if (not file_.eof()) {
+	if (version_ >= 1) {
+		std::uint64_t length;
+
+		if (read_header(current_, length)) {
+			file_.check_container_size(length);
+
+			current_.data.resize(length);
+			current_.data.resize(read_data(current_.data.data(), length));
+			++position_;
+		} else
+			current_.tsc = 0;
+	} else if (not file_.eof()) {
 		file_ >> current_;
 		++position_;
 	} else
@@ -58,10 +112,178 @@ const hardware_access& hardware_file::next()
 	return current_;
 }
 
-void hardware_file::advance_to(std::uint64_t file_position, std::uint64_t position)
+const hardware_access& hardware_file::next(const hardware_filter& filter)
+{
+	std::uint64_t length;
+
+	while (true) {
+		std::uint64_t record_position = file_.pos();
+
+		if (file_.eof() || not read_header(current_, length)) {
+			last_read_position_ = record_position;
+			current_.tsc = 0;
+			return current_;
+		}
+
+		++position_;
+
+		if (filter.matches(current_, length)) {
+			file_.check_container_size(length);
+
+			current_.data.resize(length);
+			current_.data.resize(read_data(current_.data.data(), length));
+
+			last_read_position_ = record_position;
+			return current_;
+		}
+
+		skip_data(length);
+	}
+}
+
+bool hardware_file::read_header(hardware_access_header& header, std::uint64_t& length)
+{
+	if (version_ >= 1) {
+		if (record_index_ >= record_count_) {
+			header.tsc = 0;
+			return false;
+		}
+
+		file_ >> header >> data_offset_ >> length;
+		++record_index_;
+
+		return not file_.eof();
+	}
+
+	file_ >> header >> length;
+
+	return not file_.eof();
+}
+
+std::uint64_t hardware_file::read_data(std::uint8_t* destination, std::uint64_t length)
+{
+	if (version_ == 0)
+		return file_.read_bulk(reinterpret_cast<char*>(destination), length);
+
+	if (version_ >= 2) {
+		if (not payloads_->read(data_offset_, length, destination))
+			throw std::runtime_error("Corrupted payload store");
+		return length;
+	}
+
+	// The heap is written in the order of the table, so this is usually sequential.
+	if (heap_position_ != heap_offset_ + data_offset_) {
+		heap_position_ = heap_offset_ + data_offset_;
+		heap_file_.seek(heap_position_);
+	}
+
+	std::uint64_t read = heap_file_.read_bulk(reinterpret_cast<char*>(destination), length);
+	heap_position_ += read;
+
+	return read;
+}
+
+void hardware_file::skip_data(std::uint64_t length)
+{
+	if (version_ == 0)
+		file_.skip(length);
+}
+
+void hardware_file::seek_record(std::uint64_t file_position)
 {
 	file_.seek(file_position);
 
+	if (version_ >= 1)
+		record_index_ = (file_position - table_offset_) / v1_entry_size;
+}
+
+bool hardware_file::read_into(hardware_batch& batch, bool has_tsc_limit, std::uint64_t tsc_limit)
+{
+	hardware_batch::entry entry;
+
+	entry.file_position = file_.pos();
+
+	if (not read_header(entry, entry.length))
+		return false;
+
+	if (has_tsc_limit && entry.tsc >= tsc_limit) {
+		seek_record(entry.file_position);
+		return false;
+	}
+
+	file_.check_container_size(entry.length);
+
+	entry.data_offset = batch.payload_.size();
+	batch.payload_.resize(entry.data_offset + entry.length);
+
+	// Version 2 payloads are decoded all at once when the batch is complete, the destination is filled in then.
+	if (version_ >= 2)
+		pending_payloads_.push_back({data_offset_, entry.length, nullptr});
+	else
+		read_data(batch.payload_.data() + entry.data_offset, entry.length);
+
+	batch.entries_.push_back(entry);
+	return true;
+}
+
+void hardware_file::decode_pending_payloads(hardware_batch& batch)
+{
+	if (pending_payloads_.empty())
+		return;
+
+	std::size_t first = batch.entries_.size() - pending_payloads_.size();
+	for (std::size_t i = 0; i < pending_payloads_.size(); ++i) {
+		pending_payloads_[i].destination = batch.payload_.data() + batch.entries_[first + i].data_offset;
+	}
+
+	bool good = payloads_->read(pending_payloads_, threads_);
+	pending_payloads_.clear();
+
+	if (not good)
+		throw std::runtime_error("Corrupted payload store");
+}
+
+void hardware_file::finish_batch(const hardware_batch& batch, std::size_t count)
+{
+	if (count == 0) {
+		if (file_.eof() || (version_ >= 1 && record_index_ >= record_count_))
+			current_.tsc = 0;
+		return;
+	}
+
+	position_ += count;
+	last_read_position_ = batch.entries_.back().file_position;
+	current_ = batch.access(batch.size() - 1);
+}
+
+std::size_t hardware_file::read_batch(hardware_batch& batch, std::size_t count)
+{
+	std::size_t read = 0;
+
+	while (read < count && not file_.eof() && read_into(batch, false, 0))
+		++read;
+
+	decode_pending_payloads(batch);
+	finish_batch(batch, read);
+	return read;
+}
+
+std::size_t hardware_file::read_until_tsc(hardware_batch& batch, std::uint64_t tsc)
+{
+	std::size_t read = 0;
+
+	while (not file_.eof() && read_into(batch, true, tsc))
+		++read;
+
+	decode_pending_payloads(batch);
+	finish_batch(batch, read);
+	return read;
+}
+
+void hardware_file::advance_to(std::uint64_t file_position, std::uint64_t position)
+{
+	seek_record(file_position);
+
 	if (position == 0) {
 		position_ = 0;
 		return;
@@ -70,9 +292,44 @@ void hardware_file::advance_to(std::uint64_t file_position, std::uint64_t positi
 	next();
 }
 
+bool hardware_file::seek_tsc(std::uint64_t tsc)
+{
+	if (not file_.is_open())
+		return false;
+
+	if (version_ == 0) {
+		advance_to(sizeof(std::uint64_t) + sizeof(std::uint32_t), 0);
+		while (next().valid() && current_.tsc < tsc)
+			;
+		return current_.valid();
+	}
+
+	// Binary search the first entry whose TSC is not lower than tsc.
+	std::uint64_t first = 0;
+	std::uint64_t count = record_count_;
+
+	while (count > 0) {
+		std::uint64_t half = count / 2;
+		std::uint64_t entry_tsc;
+
+		file_.seek(table_offset_ + (first + half) * v1_entry_size);
+		file_ >> entry_tsc;
+
+		if (entry_tsc < tsc) {
+			first += half + 1;
+			count -= half + 1;
+		} else {
+			count = half;
+		}
+	}
+
+	advance_to(table_offset_ + first * v1_entry_size, first + 1);
+	return current_.valid();
+}
+
 void hardware_file::sync_with(const hardware_file& other)
 {
-	file_.seek(other.file_.pos());
+	seek_record(other.file_.pos());
 	position_ = other.position_;
 
 	current_ = other.current_;
@@ -0,0 +1,163 @@
+#include <hardware_index.h>
+#include <index_header.h>
+#include <mapped_hardware_file.h>
+#include <streamable_outfile.h>
+
+#include <algorithm>
+
+namespace reven {
+namespace vmghost {
+
+static streamable_file& operator>>(streamable_file& in, hardware_index::entry& entry)
+{
+	in >> entry.ordinal >> entry.file_position >> entry.tsc >> entry.preceding_max_tsc;
+	return in;
+}
+
+static streamable_outfile& operator<<(streamable_outfile& out, const hardware_index::entry& entry)
+{
+	out << entry.ordinal << entry.file_position << entry.tsc << entry.preceding_max_tsc;
+	return out;
+}
+
+hardware_index::hardware_index() : interval_(0), count_(0)
+{
+}
+
+std::string hardware_index::index_file_name(const std::string& hardware_file_name)
+{
+	return hardware_file_name + ".idx";
+}
+
+bool hardware_index::build(const std::string& hardware_file_name, std::uint64_t interval)
+{
+	entries_.clear();
+	count_ = 0;
+	interval_ = std::max<std::uint64_t>(interval, 1);
+	hardware_file_name_ = hardware_file_name;
+
+	if (not file_stamp::of(hardware_file_name, stamp_))
+		return false;
+
+	mapped_hardware_file file;
+	if (not file.load(hardware_file_name))
+		return false;
+
+	std::uint64_t max_tsc = 0;
+
+	while (file.next().valid()) {
+		const hardware_access_view& access = file.current();
+
+		if (count_ % interval_ == 0)
+			entries_.push_back({count_, file.file_position(), access.tsc, max_tsc});
+
+		max_tsc = std::max(max_tsc, access.tsc);
+		++count_;
+	}
+
+	return true;
+}
+
+bool hardware_index::load(const std::string& hardware_file_name)
+{
+	entries_.clear();
+	count_ = 0;
+	hardware_file_name_ = hardware_file_name;
+
+	file_stamp current_stamp;
+	if (not file_stamp::of(hardware_file_name, current_stamp))
+		return false;
+
+	streamable_file file;
+	file.load(index_file_name(hardware_file_name));
+
+	if (not read_index_header(file, HARDWARE_INDEX_MAGIC, HARDWARE_INDEX_VERSION, current_stamp))
+		return false;
+
+	stamp_ = current_stamp;
+	file >> interval_ >> count_ >> entries_;
+
+	if (file.eof() || interval_ == 0 || entries_.size() != (count_ + interval_ - 1) / interval_) {
+		entries_.clear();
+		count_ = 0;
+		return false;
+	}
+
+	return true;
+}
+
+bool hardware_index::save() const
+{
+	streamable_outfile out;
+	out.open(index_file_name(hardware_file_name_));
+
+	if (not out.is_open())
+		return false;
+
+	write_index_header(out, HARDWARE_INDEX_MAGIC, HARDWARE_INDEX_VERSION, stamp_);
+	out << interval_ << count_ << entries_;
+	out.close();
+
+	return out.good();
+}
+
+bool hardware_index::load_or_build(const std::string& hardware_file_name, std::uint64_t interval)
+{
+	if (load(hardware_file_name))
+		return true;
+
+	if (not build(hardware_file_name, interval))
+		return false;
+
+	// The index is still usable if it cannot be saved, e.g. in a read-only directory.
+	save();
+	return true;
+}
+
+const hardware_index::entry& hardware_index::lookup_ordinal(std::uint64_t ordinal) const
+{
+	return entries_[std::min<std::uint64_t>(ordinal / interval_, entries_.size() - 1)];
+}
+
+const hardware_index::entry& hardware_index::lookup_tsc(std::uint64_t tsc) const
+{
+	// All the accesses before the first entry whose preceding accesses reach tsc are lower than tsc: the access we
+	// are looking for is after the entry just before it.
+	auto it = std::lower_bound(entries_.begin(), entries_.end(), tsc,
+	                           [](const entry& e, std::uint64_t value) { return e.preceding_max_tsc < value; });
+
+	if (it != entries_.begin())
+		--it;
+
+	return *it;
+}
+
+bool hardware_index::seek(hardware_file& file, std::uint64_t ordinal) const
+{
+	if (ordinal >= count_)
+		return false;
+
+	const entry& e = lookup_ordinal(ordinal);
+
+	file.advance_to(e.file_position, e.ordinal + 1);
+	for (std::uint64_t i = e.ordinal; i < ordinal; ++i)
+		file.next();
+
+	return file.current().valid();
+}
+
+bool hardware_index::seek_tsc(hardware_file& file, std::uint64_t tsc) const
+{
+	if (entries_.empty())
+		return false;
+
+	const entry& e = lookup_tsc(tsc);
+
+	file.advance_to(e.file_position, e.ordinal + 1);
+	while (file.current().valid() && file.current().tsc < tsc)
+		file.next();
+
+	return file.current().valid();
+}
+}
+} // namespace reven::vmghost
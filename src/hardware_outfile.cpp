@@ -0,0 +1,157 @@
+#include <hardware_outfile.h>
+#include <streamable_file.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+std::string table_file_name(const std::string& file_name)
+{
+	return file_name + ".table";
+}
+}
+
+hardware_outfile::hardware_outfile() : version_(0), heap_size_(0), last_tsc_(0), count_(0)
+{
+}
+
+hardware_outfile::~hardware_outfile()
+{
+	if (table_.is_open()) {
+		table_.close();
+		std::remove(table_file_name(file_name_).c_str());
+	}
+}
+
+bool hardware_outfile::open(const std::string& file_name, std::uint32_t version)
+{
+	if (version > HARDWARE_FILE_VERSION) {
+		std::stringstream error_msg;
+
+		error_msg << "This version number is not handled: "
+		          << std::dec << version
+		          << ", expecting version "
+		          << std::dec << HARDWARE_FILE_VERSION;
+
+		throw std::runtime_error(error_msg.str());
+	}
+
+	file_name_ = file_name;
+	version_ = version;
+	heap_size_ = 0;
+	last_tsc_ = 0;
+	count_ = 0;
+
+	out_.open(file_name);
+	if (not out_.is_open())
+		return false;
+
+	std::uint64_t magic = HARDWARE_FILE_MAGIC;
+	out_ << magic << version;
+
+	if (version_ >= 1) {
+		table_.open(table_file_name(file_name));
+		if (not table_.is_open())
+			return false;
+
+		if (version_ >= 2 && not payloads_.open(payload_store::store_file_name(file_name)))
+			return false;
+
+		// The count and the table offset are filled when closing.
+		std::uint64_t count = 0;
+		std::uint64_t table_offset = 0;
+		std::uint64_t heap_offset = hardware_file::v1_header_size;
+		out_ << count << table_offset << heap_offset;
+	}
+
+	return true;
+}
+
+void hardware_outfile::write(const hardware_access& access)
+{
+	if (version_ >= 1) {
+		write(access, access.data.data(), access.length());
+		return;
+	}
+
+	out_ << access;
+	++count_;
+}
+
+void hardware_outfile::write(const hardware_access_header& header, const std::uint8_t* data, std::uint64_t length)
+{
+	if (version_ >= 1) {
+		if (count_ > 0 && header.tsc < last_tsc_) {
+			std::stringstream error_msg;
+
+			error_msg << "Accesses must be written in TSC order: " << std::dec << header.tsc << " follows "
+			          << last_tsc_;
+
+			throw std::runtime_error(error_msg.str());
+		}
+
+		if (version_ >= 2) {
+			table_ << header << payloads_.add(data, length) << length;
+		} else {
+			table_ << header << heap_size_ << length;
+			out_.write_raw(reinterpret_cast<const char*>(data), length);
+			heap_size_ += length;
+		}
+
+		last_tsc_ = header.tsc;
+		++count_;
+		return;
+	}
+
+	out_ << header << length;
+	out_.write_raw(reinterpret_cast<const char*>(data), length);
+	++count_;
+}
+
+bool hardware_outfile::close()
+{
+	if (version_ >= 1 && table_.is_open()) {
+		table_.close();
+		bool good = table_.good();
+
+		// Append the metadata table after the data.
+		std::uint64_t table_offset = hardware_file::v1_header_size + heap_size_;
+
+		streamable_file table;
+		table.load(table_file_name(file_name_));
+
+		std::vector<char> buffer(1 << 20);
+		std::uint64_t remaining = count_ * hardware_file::v1_entry_size;
+
+		while (good && remaining > 0) {
+			std::uint64_t chunk = std::min<std::uint64_t>(remaining, buffer.size());
+			if (table.read_bulk(buffer.data(), chunk) != chunk)
+				good = false;
+			out_.write_raw(buffer.data(), chunk);
+			remaining -= chunk;
+		}
+		table.close();
+		std::remove(table_file_name(file_name_).c_str());
+
+		if (version_ >= 2 && not payloads_.close())
+			good = false;
+
+		out_.seek(sizeof(std::uint64_t) + sizeof(std::uint32_t));
+		out_ << count_ << table_offset;
+
+		out_.close();
+		return good && out_.good();
+	}
+
+	out_.close();
+	return out_.good();
+}
+}
+} // namespace reven::vmghost
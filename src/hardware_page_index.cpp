@@ -0,0 +1,190 @@
+#include <hardware_page_index.h>
+#include <hardware_scan.h>
+#include <index_header.h>
+#include <mapped_hardware_file.h>
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+bool page_tsc_order(const hardware_page_index::entry& lhs, const hardware_page_index::entry& rhs)
+{
+	return lhs.page < rhs.page || (lhs.page == rhs.page && (lhs.tsc < rhs.tsc || (lhs.tsc == rhs.tsc &&
+	                                                                              lhs.ordinal < rhs.ordinal)));
+}
+
+bool tsc_order(const hardware_page_index::entry& lhs, const hardware_page_index::entry& rhs)
+{
+	return lhs.tsc < rhs.tsc || (lhs.tsc == rhs.tsc && lhs.ordinal < rhs.ordinal);
+}
+}
+
+constexpr unsigned hardware_page_index::page_shift;
+
+std::string hardware_page_index::index_file_name(const std::string& hardware_file_name)
+{
+	return hardware_file_name + ".pages";
+}
+
+bool hardware_page_index::build(const std::string& hardware_file_name, unsigned threads)
+{
+	entries_.clear();
+	hardware_file_name_ = hardware_file_name;
+
+	if (not file_stamp::of(hardware_file_name, stamp_))
+		return false;
+
+	std::shared_ptr<const hardware_mapping> mapping = hardware_mapping::open(hardware_file_name);
+	if (not mapping)
+		return false;
+
+	// Collect the entries of each range of records on its own thread, then concatenate them in file order.
+	threads = effective_threads(threads);
+
+	std::vector<hardware_record_range> ranges = split_hardware_records(*mapping, threads, threads);
+	std::vector<std::vector<entry>> range_entries(ranges.size());
+
+	for_each_slice(ranges.size(), threads, [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i) {
+			const hardware_record_range& range = ranges[i];
+			std::vector<entry>& entries = range_entries[i];
+
+			mapped_hardware_file file;
+			file.load(mapping);
+			file.advance_to(range.begin, 0);
+
+			for (std::uint64_t ordinal = range.first_ordinal; ordinal < range.first_ordinal + range.count; ++ordinal) {
+				const hardware_access_view& access = file.next();
+
+				// The ranges end before the first invalid access, unless the file changed since they were split.
+				if (not access.valid())
+					break;
+
+				if (access.is_port())
+					continue;
+
+				std::uint64_t address = access.physical_address;
+				std::uint64_t length = std::min(access.length, UINT64_MAX - address);
+
+				std::uint64_t first_page = address >> page_shift;
+				std::uint64_t last_page = first_page;
+				if (length > 0)
+					last_page = (address + length - 1) >> page_shift;
+
+				for (std::uint64_t page = first_page; page <= last_page; ++page) {
+					entries.push_back({page, access.tsc, ordinal, file.file_position(), address, length});
+				}
+			}
+		}
+	});
+
+	for (auto& entries : range_entries) {
+		entries_.insert(entries_.end(), entries.begin(), entries.end());
+		std::vector<entry>().swap(entries);
+	}
+
+	// Sort slices in parallel, then merge them.
+	if (entries_.size() < 65536)
+		threads = 1;
+
+	for_each_slice(entries_.size(), threads, [this](unsigned, std::size_t begin, std::size_t end) {
+		std::sort(entries_.begin() + begin, entries_.begin() + end, page_tsc_order);
+	});
+
+	for (unsigned merged = 1; merged < threads; ++merged) {
+		std::inplace_merge(entries_.begin(), entries_.begin() + entries_.size() * merged / threads,
+		                   entries_.begin() + entries_.size() * (merged + 1) / threads, page_tsc_order);
+	}
+
+	return true;
+}
+
+bool hardware_page_index::load(const std::string& hardware_file_name)
+{
+	entries_.clear();
+	hardware_file_name_ = hardware_file_name;
+
+	file_stamp current_stamp;
+	if (not file_stamp::of(hardware_file_name, current_stamp))
+		return false;
+
+	streamable_file file;
+	file.load(index_file_name(hardware_file_name));
+
+	if (not read_index_header(file, HARDWARE_PAGE_INDEX_MAGIC, HARDWARE_PAGE_INDEX_VERSION, current_stamp))
+		return false;
+
+	stamp_ = current_stamp;
+	return read_index_vector(file, entries_);
+}
+
+bool hardware_page_index::save() const
+{
+	streamable_outfile out;
+	out.open(index_file_name(hardware_file_name_));
+
+	if (not out.is_open())
+		return false;
+
+	write_index_header(out, HARDWARE_PAGE_INDEX_MAGIC, HARDWARE_PAGE_INDEX_VERSION, stamp_);
+	write_index_vector(out, entries_);
+	out.close();
+
+	return out.good();
+}
+
+bool hardware_page_index::load_or_build(const std::string& hardware_file_name, unsigned threads)
+{
+	if (load(hardware_file_name))
+		return true;
+
+	if (not build(hardware_file_name, threads))
+		return false;
+
+	// The index is still usable if it cannot be saved, e.g. in a read-only directory.
+	save();
+	return true;
+}
+
+std::vector<hardware_page_index::entry> hardware_page_index::query(std::uint64_t address, std::uint64_t length) const
+{
+	std::vector<entry> result;
+
+	length = std::min(length, UINT64_MAX - address);
+
+	std::uint64_t first_page = address >> page_shift;
+	std::uint64_t last_page = first_page;
+	if (length > 0)
+		last_page = (address + length - 1) >> page_shift;
+
+	auto first = std::lower_bound(entries_.begin(), entries_.end(), first_page,
+	                              [](const entry& e, std::uint64_t page) { return e.page < page; });
+	auto last = std::upper_bound(first, entries_.end(), last_page,
+	                             [](std::uint64_t page, const entry& e) { return page < e.page; });
+
+	// Pages are coarser than accesses: keep the accesses that overlap the range itself.
+	std::uint64_t end = address + std::max<std::uint64_t>(length, 1);
+	std::copy_if(first, last, std::back_inserter(result), [address, end](const entry& e) {
+		return e.address < end && e.address + std::max<std::uint64_t>(e.length, 1) > address;
+	});
+
+	// Keep a single result per access, the one for its first page in the range.
+	std::stable_sort(result.begin(), result.end(), [](const entry& lhs, const entry& rhs) {
+		return lhs.ordinal < rhs.ordinal;
+	});
+	result.erase(std::unique(result.begin(), result.end(),
+	                         [](const entry& lhs, const entry& rhs) { return lhs.ordinal == rhs.ordinal; }),
+	             result.end());
+
+	std::sort(result.begin(), result.end(), tsc_order);
+
+	return result;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,99 @@
+#include <hardware_payload.h>
+
+#include <algorithm>
+
+namespace reven {
+namespace vmghost {
+
+constexpr std::size_t hardware_payload::inline_capacity;
+
+hardware_payload::hardware_payload(const std::uint8_t* first, const std::uint8_t* last) : size_(0)
+{
+	assign(first, last);
+}
+
+hardware_payload::hardware_payload(const hardware_payload& other) : size_(0)
+{
+	assign(other.begin(), other.end());
+}
+
+hardware_payload::hardware_payload(hardware_payload&& other) noexcept : size_(other.size_)
+{
+	if (other.is_inline()) {
+		std::memcpy(inline_, other.inline_, size_);
+	} else {
+		heap_ = other.heap_;
+	}
+	other.size_ = 0;
+}
+
+hardware_payload& hardware_payload::operator=(const hardware_payload& other)
+{
+	if (this != &other)
+		assign(other.begin(), other.end());
+	return *this;
+}
+
+hardware_payload& hardware_payload::operator=(hardware_payload&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		size_ = other.size_;
+		if (other.is_inline()) {
+			std::memcpy(inline_, other.inline_, size_);
+		} else {
+			heap_ = other.heap_;
+		}
+		other.size_ = 0;
+	}
+	return *this;
+}
+
+void hardware_payload::resize(std::size_t size)
+{
+	if (size == size_)
+		return;
+
+	std::uint8_t* previous = data();
+	bool was_inline = is_inline();
+
+	if (size <= inline_capacity) {
+		if (not was_inline) {
+			std::memcpy(inline_, previous, size);
+			delete[] previous;
+		} else if (size > size_) {
+			std::memset(inline_ + size_, 0, size - size_);
+		}
+	} else {
+		std::uint8_t* buffer = new std::uint8_t[size];
+		std::size_t kept = std::min(size, size_);
+		std::memcpy(buffer, previous, kept);
+		std::memset(buffer + kept, 0, size - kept);
+		if (not was_inline)
+			delete[] previous;
+		heap_ = buffer;
+	}
+
+	size_ = size;
+}
+
+void hardware_payload::assign(const std::uint8_t* first, const std::uint8_t* last)
+{
+	std::size_t size = last - first;
+
+	if (size != size_) {
+		release();
+		size_ = 0;
+		if (size > inline_capacity)
+			heap_ = new std::uint8_t[size];
+		size_ = size;
+	}
+	std::memmove(data(), first, size);
+}
+
+bool operator==(const hardware_payload& lhs, const hardware_payload& rhs)
+{
+	return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,165 @@
+#include <hardware_file.h>
+#include <hardware_outfile.h>
+#include <hardware_pruner.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+//! Byte ranges, as disjoint [begin, end) intervals indexed by begin.
+class byte_ranges {
+public:
+	bool covers(std::uint64_t begin, std::uint64_t end) const
+	{
+		auto it = ranges_.upper_bound(begin);
+		if (it == ranges_.begin())
+			return false;
+		--it;
+		return it->first <= begin && end <= it->second;
+	}
+
+	void add(std::uint64_t begin, std::uint64_t end)
+	{
+		// Merge with the ranges it touches.
+		auto it = ranges_.upper_bound(begin);
+		if (it != ranges_.begin() && std::prev(it)->second >= begin)
+			--it;
+
+		while (it != ranges_.end() && it->first <= end) {
+			begin = std::min(begin, it->first);
+			end = std::max(end, it->second);
+			it = ranges_.erase(it);
+		}
+
+		ranges_.emplace(begin, end);
+	}
+
+private:
+	std::map<std::uint64_t, std::uint64_t> ranges_;
+};
+}
+
+hardware_pruner::hardware_pruner()
+  : memory_budget_(64ull << 20), output_version_(0), pending_bytes_(0), accesses_(0), pruned_accesses_(0), bytes_(0),
+    pruned_bytes_(0)
+{
+}
+
+bool hardware_pruner::prune(const std::string& source, sync_file& sync, const std::string& destination)
+{
+	pending_.clear();
+	pending_bytes_ = 0;
+	accesses_ = pruned_accesses_ = bytes_ = pruned_bytes_ = 0;
+
+	hardware_file file;
+	if (not file.load(source))
+		return false;
+
+	hardware_outfile out;
+	if (not out.open(destination, output_version_))
+		return false;
+
+	auto next_observation = [&sync]() { return sync.next().valid() ? sync.current().tsc : UINT64_MAX; };
+
+	std::uint64_t observation = next_observation();
+	std::uint64_t last_observation = 0;
+	std::uint64_t last_tsc = 0;
+
+	while (file.next().valid()) {
+		const hardware_access& access = file.current();
+
+		if (access.tsc < last_tsc) {
+			std::stringstream error_msg;
+
+			error_msg << "Hardware access $" << std::dec << file.position()
+			          << " is out of order, the file must be reordered";
+
+			throw std::runtime_error(error_msg.str());
+		}
+		last_tsc = access.tsc;
+
+		++accesses_;
+		bytes_ += access.length();
+
+		if (observation <= access.tsc) {
+			while (observation <= access.tsc) {
+				last_observation = observation;
+				observation = next_observation();
+			}
+			flush(out);
+		}
+
+		bool observes = access.is_mmio() || (not access.is_write() && not access.is_port());
+
+		if (observes || access.tsc == last_observation) {
+			flush(out);
+			push(access, false, out);
+			flush(out);
+		} else {
+			push(access, access.is_write() && not access.is_port() && access.length() > 0, out);
+		}
+	}
+
+	flush(out);
+
+	return out.close();
+}
+
+void hardware_pruner::push(const hardware_access& access, bool prunable, hardware_outfile& out)
+{
+	pending_.push_back({access, prunable});
+	pending_bytes_ += sizeof(pending_access) + access.length();
+
+	// Over budget: give up on pruning the oldest accesses.
+	while (pending_bytes_ > memory_budget_ && pending_.size() > 1) {
+		out.write(pending_.front().access);
+		pending_bytes_ -= sizeof(pending_access) + pending_.front().access.length();
+		pending_.pop_front();
+	}
+}
+
+void hardware_pruner::flush(hardware_outfile& out)
+{
+	if (pending_.empty())
+		return;
+
+	// Walk the interval backwards: an access is dead if the accesses after it already cover all its bytes.
+	std::vector<bool> dead(pending_.size(), false);
+	byte_ranges written;
+
+	for (std::size_t i = pending_.size(); i-- > 0;) {
+		const pending_access& pending = pending_[i];
+		if (not pending.prunable)
+			continue;
+
+		std::uint64_t begin = pending.access.physical_address;
+		std::uint64_t end = begin + pending.access.length();
+
+		if (written.covers(begin, end))
+			dead[i] = true;
+		else
+			written.add(begin, end);
+	}
+
+	for (std::size_t i = 0; i < pending_.size(); ++i) {
+		if (dead[i]) {
+			++pruned_accesses_;
+			pruned_bytes_ += pending_[i].access.length();
+		} else {
+			out.write(pending_[i].access);
+		}
+	}
+
+	pending_.clear();
+	pending_bytes_ = 0;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,205 @@
+#include <hardware_scan.h>
+
+#include "parallel.h"
+
+#include <algorithm>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+//! Smallest part of a version 0 file worth a thread of its own.
+constexpr std::uint64_t min_part_size = 4 << 20;
+
+//! Number of consecutive plausible records needed to accept a guessed boundary.
+constexpr unsigned boundary_chain = 8;
+
+//! Largest TSC difference between two consecutive records of a guessed chain. Files are not necessarily sorted, but
+//! consecutive accesses are never hours apart, while random bytes almost always are.
+constexpr std::uint64_t max_tsc_gap = 1ull << 44;
+
+constexpr std::uint64_t known_types = hardware_access_header::write | hardware_access_header::pci |
+                                      hardware_access_header::mmio | hardware_access_header::port;
+
+bool plausible(const hardware_access_view& access)
+{
+	if (not access.valid() || (access.type & ~known_types) != 0)
+		return false;
+
+	// Port accesses are register sized, and are neither PCI nor MMIO.
+	if (access.is_port() && (access.is_pci() || access.is_mmio() || access.length > 8))
+		return false;
+
+	return true;
+}
+
+bool close_tscs(std::uint64_t lhs, std::uint64_t rhs)
+{
+	return (lhs < rhs ? rhs - lhs : lhs - rhs) <= max_tsc_gap;
+}
+
+//! Returns true if offset starts a chain of plausible records, long enough or ending exactly at the end of the file.
+bool is_boundary(const hardware_mapping& mapping, std::uint64_t offset)
+{
+	hardware_access_view access;
+	std::uint64_t previous_tsc = 0;
+
+	for (unsigned i = 0; i < boundary_chain; ++i) {
+		std::uint64_t next = mapping.decode(offset, access);
+
+		if (next == 0 || not plausible(access) || (i > 0 && not close_tscs(previous_tsc, access.tsc)))
+			return false;
+
+		if (next == mapping.records_end())
+			return true;
+
+		offset = next;
+		previous_tsc = access.tsc;
+	}
+
+	return true;
+}
+
+//! First boundary in [begin, end), or the end of the records if there is none.
+std::uint64_t guess_boundary(const hardware_mapping& mapping, std::uint64_t begin, std::uint64_t end)
+{
+	for (std::uint64_t offset = begin; offset < end; ++offset) {
+		if (is_boundary(mapping, offset))
+			return offset;
+	}
+	return mapping.records_end();
+}
+
+//! Walks the records from begin to the first one at or after end, or to the first invalid record, where a sequential
+//! read stops. Returns the offset the walk stopped at, and counts the records.
+std::uint64_t walk(const hardware_mapping& mapping, std::uint64_t begin, std::uint64_t end, std::uint64_t& count)
+{
+	hardware_access_view access;
+
+	count = 0;
+	while (begin < end) {
+		std::uint64_t next = mapping.decode(begin, access);
+		if (next == 0 || not access.valid())
+			break;
+
+		begin = next;
+		++count;
+	}
+
+	return begin;
+}
+
+std::vector<hardware_record_range> split_fixed_size(const hardware_mapping& mapping, unsigned parts,
+                                                    unsigned threads)
+{
+	std::uint64_t records = (mapping.records_end() - mapping.first_record()) / hardware_mapping::table_entry_size;
+	parts = static_cast<unsigned>(std::max<std::uint64_t>(std::min<std::uint64_t>(parts, records), 1));
+	threads = std::min(effective_threads(threads), parts);
+
+	auto part_begin = [&](unsigned i) {
+		return mapping.first_record() + records * i / parts * hardware_mapping::table_entry_size;
+	};
+
+	// Entries may still be invalid, e.g. with a payload out of the heap: walk each part up to its first invalid one.
+	std::vector<std::uint64_t> ends(parts);
+	std::vector<std::uint64_t> counts(parts);
+
+	for_each_slice(parts, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i) {
+			unsigned part = static_cast<unsigned>(i);
+			ends[i] = walk(mapping, part_begin(part), part_begin(part + 1), counts[i]);
+		}
+	});
+
+	// Reading stops at the first invalid entry: the parts after it are dropped.
+	std::vector<hardware_record_range> ranges;
+	std::uint64_t ordinal = 0;
+
+	for (unsigned i = 0; i < parts; ++i) {
+		if (counts[i] > 0)
+			ranges.push_back({part_begin(i), ends[i], ordinal, counts[i]});
+
+		if (ends[i] < part_begin(i + 1))
+			break;
+
+		ordinal += counts[i];
+	}
+
+	return ranges;
+}
+}
+
+std::vector<hardware_record_range> split_hardware_records(const hardware_mapping& mapping, unsigned parts,
+                                                          unsigned threads)
+{
+	if (mapping.version() >= 1)
+		return split_fixed_size(mapping, parts, threads);
+
+	std::uint64_t first_record = mapping.first_record();
+	std::uint64_t records_end = mapping.records_end();
+	std::uint64_t size = records_end - first_record;
+
+	parts = static_cast<unsigned>(std::max<std::uint64_t>(std::min<std::uint64_t>(parts, size / min_part_size), 1));
+	threads = std::min(effective_threads(threads), parts);
+
+	// Guess where each part starts. The first one is known.
+	std::vector<std::uint64_t> guesses(parts + 1, records_end);
+	guesses[0] = first_record;
+
+	for_each_slice(parts - 1, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i) {
+			guesses[i + 1] = guess_boundary(mapping, first_record + size * (i + 1) / parts,
+			                                first_record + size * (i + 2) / parts);
+		}
+	});
+
+	// A part without a boundary starts where the next one does: it is empty, and the previous part covers it.
+	for (unsigned i = parts - 1; i > 0; --i) {
+		guesses[i] = std::min(guesses[i], guesses[i + 1]);
+	}
+
+	// Then walk each part from its guess to the next one.
+	std::vector<std::uint64_t> ends(parts);
+	std::vector<std::uint64_t> counts(parts);
+
+	for_each_slice(parts, threads, [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i) {
+			ends[i] = walk(mapping, guesses[i], guesses[i + 1], counts[i]);
+		}
+	});
+
+	// Check the seams: each part must start where the previous one ended, otherwise its guess was wrong and it is
+	// walked again from the right boundary.
+	std::vector<hardware_record_range> ranges;
+	std::uint64_t boundary = first_record;
+	std::uint64_t ordinal = 0;
+
+	for (unsigned i = 0; i < parts && boundary < records_end; ++i) {
+		if (guesses[i] == guesses[i + 1])
+			continue;
+
+		if (guesses[i] != boundary) {
+			// The previous walk stopped before the guess only on an invalid record, where reading stops.
+			if (boundary < guesses[i])
+				break;
+
+			ends[i] = walk(mapping, boundary, guesses[i + 1], counts[i]);
+		}
+
+		// A previous record may also span the whole part.
+		if (counts[i] > 0)
+			ranges.push_back({boundary, ends[i], ordinal, counts[i]});
+
+		// Same as above, for the end of the part.
+		if (ends[i] < guesses[i + 1])
+			break;
+
+		boundary = ends[i];
+		ordinal += counts[i];
+	}
+
+	return ranges;
+}
+}
+} // namespace reven::vmghost
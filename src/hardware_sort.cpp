@@ -0,0 +1,287 @@
+#include <hardware_outfile.h>
+#include <hardware_sort.h>
+#include <mapped_hardware_file.h>
+#include <reorder_window.h>
+#include <streamable_file.h>
+#include <streamable_outfile.h>
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+using histogram = std::array<std::uint64_t, 256>;
+
+//! Reads the sorted keys of a run spilled to disk, a block at a time.
+class run_reader {
+public:
+	explicit run_reader(const std::string& file_name) : index_(0) { file_.load(file_name); }
+
+	//! Returns false when the run is exhausted.
+	bool next(hardware_sort_key& key)
+	{
+		if (index_ == block_.size()) {
+			block_.resize(block_size);
+			std::uint64_t read = file_.read_bulk(reinterpret_cast<char*>(block_.data()), block_size * sizeof(key));
+			block_.resize(read / sizeof(key));
+			index_ = 0;
+			if (block_.empty())
+				return false;
+		}
+		key = block_[index_++];
+		return true;
+	}
+
+private:
+	static constexpr std::size_t block_size = 4096;
+
+	streamable_file file_;
+	std::vector<hardware_sort_key> block_;
+	std::size_t index_;
+};
+
+//! Removes the temporary files when destroyed, so that they do not outlive a failed sort.
+struct temporary_files {
+	~temporary_files()
+	{
+		for (const auto& name : names) {
+			std::remove(name.c_str());
+		}
+	}
+
+	std::vector<std::string> names;
+};
+
+struct merge_item {
+	hardware_sort_key key;
+	std::size_t run;
+};
+
+//! Orders the merge heap by TSC. Runs are consecutive parts of the source file, so ordering on the file position
+//! between equal TSCs keeps the sort stable.
+struct merge_item_greater {
+	bool operator()(const merge_item& lhs, const merge_item& rhs) const
+	{
+		return lhs.key.tsc > rhs.key.tsc || (lhs.key.tsc == rhs.key.tsc && lhs.key.file_position > rhs.key.file_position);
+	}
+};
+}
+
+void parallel_radix_sort(std::vector<hardware_sort_key>& keys, unsigned threads)
+{
+	threads = effective_threads(threads);
+
+	// Small inputs are not worth the threads.
+	if (keys.size() < 65536)
+		threads = 1;
+
+	// Skip the digits that are identical for all the keys: TSCs usually share most of their high bytes.
+	std::uint64_t first_tsc = keys.empty() ? 0 : keys.front().tsc;
+	std::uint64_t differing_bits = 0;
+	for (const auto& key : keys) {
+		differing_bits |= key.tsc ^ first_tsc;
+	}
+
+	std::vector<hardware_sort_key> buffer(keys.size());
+	std::vector<histogram> counts(threads);
+
+	for (unsigned shift = 0; shift < 64; shift += 8) {
+		if (((differing_bits >> shift) & 0xff) == 0)
+			continue;
+
+		for_each_slice(keys.size(), threads, [&](unsigned thread, std::size_t begin, std::size_t end) {
+			histogram& count = counts[thread];
+			count.fill(0);
+			for (std::size_t i = begin; i < end; ++i) {
+				++count[(keys[i].tsc >> shift) & 0xff];
+			}
+		});
+
+		// Each thread scatters its slice after the slices of the previous threads for every digit: the pass is stable.
+		std::uint64_t offset = 0;
+		for (unsigned digit = 0; digit < 256; ++digit) {
+			for (unsigned thread = 0; thread < threads; ++thread) {
+				std::uint64_t count = counts[thread][digit];
+				counts[thread][digit] = offset;
+				offset += count;
+			}
+		}
+
+		for_each_slice(keys.size(), threads, [&](unsigned thread, std::size_t begin, std::size_t end) {
+			histogram& position = counts[thread];
+			for (std::size_t i = begin; i < end; ++i) {
+				buffer[position[(keys[i].tsc >> shift) & 0xff]++] = keys[i];
+			}
+		});
+
+		keys.swap(buffer);
+	}
+}
+
+hardware_sorter::hardware_sorter()
+  : memory_budget_(1ull << 30), threads_(0), window_(0), output_version_(0), payload_compression_(true),
+    spilled_runs_(0), fell_back_(false)
+{
+}
+
+bool hardware_sorter::sort(const std::string& source, const std::string& destination)
+{
+	spilled_runs_ = 0;
+	fell_back_ = false;
+
+	auto mapping = hardware_mapping::open(source);
+	if (not mapping)
+		return false;
+
+	hardware_outfile out;
+	out.set_payload_compression(payload_compression_);
+	if (not out.open(destination, output_version_))
+		return false;
+
+	if (window_ != 0) {
+		if (sort_streaming(*mapping, out))
+			return out.close();
+
+		// Start over.
+		fell_back_ = true;
+		out.close();
+		if (not out.open(destination, output_version_))
+			return false;
+	}
+
+	sort_full(*mapping, out, destination);
+
+	return out.close();
+}
+
+bool hardware_sorter::sort_streaming(const hardware_mapping& mapping, hardware_outfile& out)
+{
+	reorder_window<hardware_sort_key> window(window_);
+	std::vector<std::uint8_t> payload;
+
+	auto copy_top = [&]() {
+		hardware_access_view top;
+		mapping.decode(window.pop().file_position, top, payload);
+		out.write(top);
+	};
+
+	hardware_access_view access;
+	std::uint64_t offset = mapping.first_record();
+
+	while (true) {
+		// Stop at the first invalid access, as reading the file does.
+		std::uint64_t next_offset = mapping.decode(offset, access);
+		if (next_offset == 0 || not access.valid())
+			break;
+
+		if (window.full())
+			copy_top();
+
+		if (not window.push({access.tsc, offset, next_offset - offset}))
+			return false;
+
+		offset = next_offset;
+	}
+
+	while (not window.empty())
+		copy_top();
+
+	return true;
+}
+
+void hardware_sorter::sort_full(const hardware_mapping& mapping, hardware_outfile& out, const std::string& destination)
+{
+	hardware_access_view access;
+	std::vector<std::uint8_t> payload;
+
+	auto copy_record = [&](const hardware_sort_key& key) {
+		mapping.decode(key.file_position, access, payload);
+		out.write(access);
+	};
+
+	// The radix sort needs twice the memory of the keys.
+	std::uint64_t run_capacity = std::max<std::uint64_t>(memory_budget_ / (2 * sizeof(hardware_sort_key)), 4096);
+
+	std::vector<hardware_sort_key> keys;
+	temporary_files runs;
+
+	keys.reserve(std::min(run_capacity, mapping.size() / hardware_mapping::record_header_size + 1));
+
+	auto spill = [&]() {
+		parallel_radix_sort(keys, threads_);
+
+		runs.names.push_back(destination + ".run" + std::to_string(runs.names.size()));
+
+		streamable_outfile run;
+		run.open(runs.names.back());
+		run.write_raw(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(hardware_sort_key));
+		run.close();
+
+		if (not run.good())
+			throw std::runtime_error("Could not write the temporary file " + runs.names.back());
+
+		keys.clear();
+	};
+
+	std::uint64_t offset = mapping.first_record();
+
+	while (true) {
+		// Stop at the first invalid access, as reading the file does.
+		std::uint64_t next_offset = mapping.decode(offset, access);
+		if (next_offset == 0 || not access.valid())
+			break;
+
+		keys.push_back({access.tsc, offset, next_offset - offset});
+		offset = next_offset;
+
+		if (keys.size() == run_capacity)
+			spill();
+	}
+
+	if (runs.names.empty()) {
+		// Everything fits in memory.
+		parallel_radix_sort(keys, threads_);
+		for (const auto& key : keys) {
+			copy_record(key);
+		}
+		return;
+	}
+
+	if (not keys.empty())
+		spill();
+	keys.clear();
+	keys.shrink_to_fit();
+
+	std::vector<std::unique_ptr<run_reader>> readers;
+	std::priority_queue<merge_item, std::vector<merge_item>, merge_item_greater> heap;
+
+	for (std::size_t i = 0; i < runs.names.size(); ++i) {
+		readers.emplace_back(new run_reader(runs.names[i]));
+		merge_item item{hardware_sort_key(), i};
+		if (readers[i]->next(item.key))
+			heap.push(item);
+	}
+
+	while (not heap.empty()) {
+		merge_item item = heap.top();
+		heap.pop();
+
+		copy_record(item.key);
+
+		if (readers[item.run]->next(item.key))
+			heap.push(item);
+	}
+
+	spilled_runs_ = runs.names.size();
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,66 @@
+#include <index_header.h>
+
+namespace reven {
+namespace vmghost {
+
+bool read_index_header(streamable_file& file, std::uint64_t magic, std::uint32_t version,
+                       const file_stamp& current_stamp)
+{
+	if (file.eof() || !file.is_open())
+		return false;
+
+	std::uint64_t file_magic;
+	std::uint32_t file_version;
+	file_stamp stamp;
+
+	file >> file_magic >> file_version;
+
+	if (file.eof()) {
+		return false;
+	} else if (file_magic != magic) {
+		// Not an index, e.g. a truncated or overwritten one: rebuild it.
+		return false;
+	} else if (file_version != version) {
+		// Older index, just rebuild it.
+		return false;
+	}
+
+	file >> stamp.size >> stamp.modification_time;
+
+	return not file.eof() && stamp == current_stamp;
+}
+
+void write_index_header(streamable_outfile& out, std::uint64_t magic, std::uint32_t version, const file_stamp& stamp)
+{
+	out << magic << version << stamp.size << stamp.modification_time;
+}
+
+bool read_indexed_file(streamable_file& file, const std::string& file_name, const file_stamp& current_stamp)
+{
+	std::string indexed_file_name;
+	file_stamp stamp;
+
+	file >> indexed_file_name >> stamp.size >> stamp.modification_time;
+
+	return not file.eof() && indexed_file_name == file_name && stamp == current_stamp;
+}
+
+void write_indexed_file(streamable_outfile& out, const std::string& file_name, const file_stamp& stamp)
+{
+	out << file_name << stamp.size << stamp.modification_time;
+}
+
+std::uint64_t remaining_size(streamable_file& file)
+{
+	if (file.eof())
+		return 0;
+
+	std::uint64_t position = file.pos();
+	file.seek_from_end(0);
+	std::uint64_t size = file.pos();
+	file.seek(position);
+
+	return size > position ? size - position : 0;
+}
+}
+} // namespace reven::vmghost
@@ -12,6 +12,7 @@ io_file::io_file()
 bool io_file::load(const std::string& file_path)
 {
 	devices_.clear();
+	resolver_.build(devices_);
 
 	file_.load(file_path);
 
@@ -55,6 +56,8 @@ bool io_file::load(const std::string& file_path)
 		devices_[d.id] = std::move(d);
 	}
 
+	resolver_.build(devices_);
+
 	return true;
 }
 
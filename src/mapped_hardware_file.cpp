@@ -0,0 +1,281 @@
+#include <mapped_hardware_file.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iomanip>
+#include <sstream>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+template <typename T> T read_at(const std::uint8_t* location)
+{
+	T value;
+	std::memcpy(&value, location, sizeof(value));
+	return value;
+}
+}
+
+constexpr std::uint64_t hardware_mapping::record_header_size;
+constexpr std::uint64_t hardware_mapping::table_entry_size;
+
+hardware_mapping::hardware_mapping(const std::uint8_t* base, std::uint64_t size)
+  : base_(base), size_(size), version_(0), first_record_(sizeof(std::uint64_t) + sizeof(std::uint32_t)),
+    records_end_(size), heap_offset_(0)
+{
+}
+
+hardware_mapping::~hardware_mapping()
+{
+	::munmap(const_cast<std::uint8_t*>(base_), size_);
+}
+
+std::shared_ptr<const hardware_mapping> hardware_mapping::open(const std::string& file_name)
+{
+	int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < sizeof(std::uint64_t) + sizeof(std::uint32_t)) {
+		::close(fd);
+		return nullptr;
+	}
+
+	void* base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (base == MAP_FAILED)
+		return nullptr;
+
+	::madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+	std::shared_ptr<hardware_mapping> mapping(new hardware_mapping(static_cast<const std::uint8_t*>(base), st.st_size));
+
+	std::uint64_t magic = read_at<std::uint64_t>(mapping->base_);
+	if (magic != HARDWARE_FILE_MAGIC) {
+		std::stringstream error_msg;
+
+		error_msg << "Magic number should be "
+		          << std::showbase << std::hex << HARDWARE_FILE_MAGIC
+		          << " but is actually "
+		          << std::showbase <<  std::hex << magic;
+
+		throw std::runtime_error(error_msg.str());
+	}
+	mapping->version_ = read_at<std::uint32_t>(mapping->base_ + sizeof(magic));
+
+	if (mapping->version_ > HARDWARE_FILE_VERSION) {
+		std::stringstream error_msg;
+
+		error_msg << "This version number is not handled: "
+		          << std::dec << mapping->version_
+		          << ", expecting version "
+		          << std::dec << HARDWARE_FILE_VERSION;
+
+		throw std::runtime_error(error_msg.str());
+	}
+
+	if (mapping->version_ >= 1) {
+		if (mapping->size_ < hardware_file::v1_header_size)
+			return nullptr;
+
+		std::uint64_t count = read_at<std::uint64_t>(mapping->base_ + 12);
+		std::uint64_t table_offset = read_at<std::uint64_t>(mapping->base_ + 20);
+		mapping->heap_offset_ = read_at<std::uint64_t>(mapping->base_ + 28);
+
+		if (table_offset > mapping->size_ || (mapping->size_ - table_offset) / table_entry_size < count ||
+		    mapping->heap_offset_ > table_offset)
+			throw std::runtime_error("Malformed hardware file: the metadata table is truncated");
+
+		mapping->first_record_ = table_offset;
+		mapping->records_end_ = table_offset + count * table_entry_size;
+	}
+
+	if (mapping->version_ >= 2) {
+		mapping->payloads_ = payload_store::open(payload_store::store_file_name(file_name));
+		if (not mapping->payloads_)
+			return nullptr;
+	}
+
+	return mapping;
+}
+
+std::uint64_t hardware_mapping::decode(std::uint64_t offset, hardware_access_view& view) const
+{
+	if (version_ >= 1) {
+		if (offset < first_record_ || offset >= records_end_)
+			return 0;
+
+		const std::uint8_t* entry = base_ + offset;
+
+		view.tsc = read_at<std::uint64_t>(entry);
+		view.physical_address = read_at<std::uint64_t>(entry + 8);
+		view.type = read_at<std::uint64_t>(entry + 16);
+		view.device_id = read_at<std::uint64_t>(entry + 24);
+		view.device_instance = read_at<std::uint32_t>(entry + 32);
+
+		std::uint64_t data_offset = heap_offset_ + read_at<std::uint64_t>(entry + 36);
+		view.length = read_at<std::uint64_t>(entry + 44);
+
+		if (payloads_) {
+			view.data = nullptr;
+			return offset + table_entry_size;
+		}
+
+		if (data_offset > first_record_ || view.length > first_record_ - data_offset)
+			return 0;
+
+		view.data = base_ + data_offset;
+		return offset + table_entry_size;
+	}
+
+	if (offset < first_record_ || offset > size_ || size_ - offset < record_header_size)
+		return 0;
+
+	const std::uint8_t* record = base_ + offset;
+
+	view.tsc = read_at<std::uint64_t>(record);
+	view.physical_address = read_at<std::uint64_t>(record + 8);
+	view.type = read_at<std::uint64_t>(record + 16);
+	view.device_id = read_at<std::uint64_t>(record + 24);
+	view.device_instance = read_at<std::uint32_t>(record + 32);
+	view.length = read_at<std::uint64_t>(record + 36);
+
+	std::uint64_t data_offset = offset + record_header_size;
+	if (view.length > size_ - data_offset)
+		return 0;
+
+	view.data = base_ + data_offset;
+	return data_offset + view.length;
+}
+
+std::uint64_t hardware_mapping::decode(std::uint64_t offset, hardware_access_view& view,
+                                       std::vector<std::uint8_t>& buffer) const
+{
+	std::uint64_t next_offset = decode(offset, view);
+
+	if (next_offset == 0 || not payloads_)
+		return next_offset;
+
+	std::uint64_t reference = read_at<std::uint64_t>(base_ + offset + 36);
+
+	buffer.resize(view.length);
+	if (not payloads_->read(reference, view.length, buffer.data()))
+		throw std::runtime_error("Corrupted payload store");
+
+	view.data = buffer.data();
+	return next_offset;
+}
+
+mapped_hardware_file::mapped_hardware_file() : next_position_(0), last_read_position_(0), position_(0)
+{
+}
+
+mapped_hardware_file::mapped_hardware_file(const mapped_hardware_file& other)
+{
+	*this = other;
+}
+
+mapped_hardware_file& mapped_hardware_file::operator=(const mapped_hardware_file& other)
+{
+	mapping_ = other.mapping_;
+	current_ = other.current_;
+	payload_ = other.payload_;
+	next_position_ = other.next_position_;
+	last_read_position_ = other.last_read_position_;
+	position_ = other.position_;
+
+	// The data of version 2 files points to the buffer of the reader.
+	if (mapping_ && mapping_->payloads() && current_.data != nullptr)
+		current_.data = payload_.data();
+
+	return *this;
+}
+
+bool mapped_hardware_file::load(const std::string& file_name)
+{
+	return load(hardware_mapping::open(file_name));
+}
+
+bool mapped_hardware_file::load(std::shared_ptr<const hardware_mapping> mapping)
+{
+	mapping_ = std::move(mapping);
+	current_ = hardware_access_view();
+	position_ = 0;
+
+	if (not mapping_) {
+		next_position_ = last_read_position_ = 0;
+		return false;
+	}
+
+	next_position_ = last_read_position_ = mapping_->first_record();
+	return true;
+}
+
+const hardware_access_view& mapped_hardware_file::next()
+{
+	last_read_position_ = next_position_;
+
+	std::uint64_t next_position = mapping_ ? mapping_->decode(next_position_, current_, payload_) : 0;
+
+	if (next_position == 0) {
+		current_ = hardware_access_view();
+		return current_;
+	}
+
+	next_position_ = next_position;
+	++position_;
+
+	return current_;
+}
+
+const hardware_access_view& mapped_hardware_file::next(const hardware_filter& filter)
+{
+	if (mapping_ && mapping_->payloads()) {
+		// Only decode the payloads of the selected accesses.
+		while (std::uint64_t next_position = mapping_->decode(next_position_, current_)) {
+			last_read_position_ = next_position_;
+			next_position_ = next_position;
+			++position_;
+
+			if (filter.matches(current_, current_.length)) {
+				mapping_->decode(last_read_position_, current_, payload_);
+				return current_;
+			}
+		}
+
+		last_read_position_ = next_position_;
+		current_ = hardware_access_view();
+		return current_;
+	}
+
+	while (next().valid() && not filter.matches(current_, current_.length))
+		;
+
+	return current_;
+}
+
+void mapped_hardware_file::advance_to(std::uint64_t file_position, std::uint64_t position)
+{
+	next_position_ = file_position;
+
+	if (position == 0) {
+		position_ = 0;
+		return;
+	}
+	position_ = position - 1;
+	next();
+}
+
+void mapped_hardware_file::sync_with(const mapped_hardware_file& other)
+{
+	*this = other;
+}
+}
+} // namespace reven::vmghost
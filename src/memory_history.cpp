@@ -0,0 +1,234 @@
+#include <memory_history.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+bool is_memory_write(const hardware_access_view& access)
+{
+	return access.is_write() && not access.is_port() && access.length > 0;
+}
+
+//! Calls f(address, data, length) for each hardware write before tsc, and moves the file to the first access at or
+//! after it. Throws if the file is not sorted by TSC.
+template <typename F> void replay_hardware(mapped_hardware_file& hardware, std::uint64_t tsc, F f)
+{
+	while (hardware.current().valid() && hardware.current().tsc < tsc) {
+		const hardware_access_view& access = hardware.current();
+
+		if (is_memory_write(access))
+			f(access.physical_address, access.data, access.length);
+
+		std::uint64_t previous_tsc = access.tsc;
+		if (hardware.next().valid() && hardware.current().tsc < previous_tsc) {
+			std::stringstream error_msg;
+
+			error_msg << "Hardware access $" << std::dec << hardware.position()
+			          << " is out of order, the file must be reordered";
+
+			throw std::runtime_error(error_msg.str());
+		}
+	}
+}
+
+//! Calls f(address, data, length) for each physical dump of the sync point.
+template <typename F> void replay_dumps(const sync_point& point, F f)
+{
+	for (const auto& dump : point.data) {
+		if (dump.type == sync_point_data_type::memory_physical && not dump.data.empty())
+			f(dump.offset, dump.data.data(), dump.data.size());
+	}
+}
+}
+
+constexpr unsigned memory_history::page_shift;
+constexpr std::uint64_t memory_history::page_size;
+
+memory_history::memory_history() : checkpoint_interval_(1024), has_hardware_(false), last_position_(0)
+{
+}
+
+bool memory_history::build(const std::string& sync_file_name, const std::string& data_file_name,
+                           const std::string& hardware_file_name)
+{
+	checkpoints_.clear();
+	page_versions_.clear();
+	last_position_ = 0;
+
+	if (not sync_.load(sync_file_name, data_file_name))
+		return false;
+
+	checkpoint state;
+	state.position = 0;
+
+	has_hardware_ = not hardware_file_name.empty();
+	if (has_hardware_) {
+		if (not state.hardware.load(hardware_file_name))
+			return false;
+		state.hardware.next();
+	}
+
+	checkpoints_.push_back(state);
+
+	// The memory as it is now, and the pages written since the last checkpoint.
+	page_map pages;
+	std::vector<std::uint64_t> dirty;
+
+	auto write_state = [&pages, &dirty](std::uint64_t address, const std::uint8_t* data, std::uint64_t length) {
+		write(pages, dirty, address, data, length);
+	};
+
+	std::uint64_t interval = std::max<std::uint64_t>(checkpoint_interval_, 1);
+
+	while (sync_.next().valid()) {
+		const sync_point& point = sync_.current();
+
+		if (has_hardware_)
+			replay_hardware(state.hardware, point.tsc, write_state);
+		replay_dumps(point, write_state);
+
+		state.position = last_position_ = sync_.position();
+
+		if (state.position - checkpoints_.back().position >= interval) {
+			checkpoints_.push_back(state);
+
+			// The checkpoint shares the dirty pages: they are copied again when written.
+			for (std::uint64_t page_number : dirty)
+				page_versions_[page_number].push_back({state.position, pages[page_number]});
+			dirty.clear();
+		}
+	}
+
+	return true;
+}
+
+bool memory_history::read(std::uint64_t position, std::uint64_t address, std::uint64_t length, std::uint8_t* buffer)
+{
+	position = std::min(position, last_position_);
+	length = std::min(length, UINT64_MAX - address);
+
+	auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), position,
+	                           [](std::uint64_t position, const checkpoint& c) { return position < c.position; });
+	if (it == checkpoints_.begin())
+		return false;
+
+	bool complete = read_from(*std::prev(it), position, address, length, buffer);
+
+#ifdef RVN_MEMORY_HISTORY_DEBUG
+	std::vector<std::uint8_t> replayed(length);
+	bool replayed_complete = read_from(checkpoints_.front(), position, address, length, replayed.data());
+
+	if (complete != replayed_complete || not std::equal(replayed.begin(), replayed.end(), buffer)) {
+		std::stringstream error_msg;
+
+		error_msg << "Memory at " << std::showbase << std::hex << address << " differs from its replay at $"
+		          << std::dec << position;
+
+		throw std::runtime_error(error_msg.str());
+	}
+#endif
+
+	return complete;
+}
+
+bool memory_history::read_from(const checkpoint& start, std::uint64_t position, std::uint64_t address,
+                               std::uint64_t length, std::uint8_t* buffer)
+{
+	std::vector<bool> known(length, false);
+	std::memset(buffer, 0, length);
+
+	auto write_buffer = [&](std::uint64_t begin, const std::uint8_t* data, std::uint64_t size) {
+		std::uint64_t end = begin + std::min(size, UINT64_MAX - begin);
+		std::uint64_t first = std::max(begin, address);
+		std::uint64_t last = std::min(end, address + length);
+
+		if (first >= last)
+			return;
+
+		std::memcpy(buffer + (first - address), data + (first - begin), last - first);
+		std::fill(known.begin() + (first - address), known.begin() + (last - address), true);
+	};
+
+	// The checkpoint first: the last version of each page up to it.
+	std::uint64_t end = address + length;
+	for (auto page_it = page_versions_.lower_bound(address >> page_shift);
+	     page_it != page_versions_.end() && (page_it->first << page_shift) < end; ++page_it) {
+		const std::vector<page_version>& versions = page_it->second;
+
+		auto version = std::upper_bound(
+		    versions.begin(), versions.end(), start.position,
+		    [](std::uint64_t position, const page_version& v) { return position < v.position; });
+		if (version == versions.begin())
+			continue;
+
+		std::uint64_t page_address = page_it->first << page_shift;
+		const page& p = *std::prev(version)->content;
+
+		std::uint64_t first = std::max(page_address, address);
+		std::uint64_t last = std::min(page_address + page_size, end);
+
+		for (std::uint64_t byte = first; byte < last; ++byte) {
+			if (p.known[byte - page_address]) {
+				buffer[byte - address] = p.bytes[byte - page_address];
+				known[byte - address] = true;
+			}
+		}
+	}
+
+	// Then what happened since. The checkpoint was taken right after its sync point.
+	mapped_hardware_file hardware = start.hardware;
+
+	sync_.seek_point(start.position);
+
+	while (sync_.position() < position && sync_.next().valid()) {
+		// Duplicated sync points are skipped, and may have moved past the position.
+		if (sync_.position() > position)
+			break;
+
+		const sync_point& point = sync_.current();
+
+		if (has_hardware_)
+			replay_hardware(hardware, point.tsc, write_buffer);
+		replay_dumps(point, write_buffer);
+	}
+
+	return std::find(known.begin(), known.end(), false) == known.end();
+}
+
+void memory_history::write(page_map& pages, std::vector<std::uint64_t>& dirty, std::uint64_t address,
+                           const std::uint8_t* data, std::uint64_t length)
+{
+	length = std::min(length, UINT64_MAX - address);
+
+	while (length > 0) {
+		std::uint64_t offset = address & (page_size - 1);
+		std::uint64_t size = std::min(length, page_size - offset);
+
+		// A page is new, or shared with a checkpoint, until it is first written after the checkpoint.
+		std::shared_ptr<page>& p = pages[address >> page_shift];
+		if (not p) {
+			p = std::make_shared<page>();
+			dirty.push_back(address >> page_shift);
+		} else if (p.use_count() > 1) {
+			p = std::make_shared<page>(*p);
+			dirty.push_back(address >> page_shift);
+		}
+
+		std::memcpy(p->bytes + offset, data, size);
+		for (std::uint64_t i = offset; i < offset + size; ++i) {
+			p->known.set(i);
+		}
+
+		address += size;
+		data += size;
+		length -= size;
+	}
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace reven {
+namespace vmghost {
+
+//! Number of threads to use when 0 means one per CPU.
+inline unsigned effective_threads(unsigned threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	return std::max(threads, 1u);
+}
+
+//! Runs f(thread_index, begin, end) on each slice of [0, size) on its own thread.
+template <typename F> void for_each_slice(std::size_t size, unsigned threads, F f)
+{
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; ++i) {
+		workers.emplace_back(f, i, size * i / threads, size * (i + 1) / threads);
+	}
+	f(0, 0, size / threads);
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,474 @@
+#include <payload_store.h>
+
+#include "content_hash.h"
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+constexpr std::uint64_t header_size = 8 + 4 + 4 + 8 + 8;
+constexpr std::uint64_t chunk_entry_size = 8 + 4 + 4;
+constexpr std::size_t write_buffer_size = 1 << 20;
+constexpr std::size_t cache_size = 64;
+
+template <typename T> T read_at(const std::uint8_t* location)
+{
+	T value;
+	std::memcpy(&value, location, sizeof(value));
+	return value;
+}
+
+template <typename T> void write_at(std::uint8_t* location, T value)
+{
+	std::memcpy(location, &value, sizeof(value));
+}
+
+// The codec is a byte oriented LZ77 working on a single chunk. Each token starts with a control byte:
+//  - 0 to 127: a run of control + 1 literal bytes follows.
+//  - 128 to 255: copy (control & 127) + min_match bytes from offset bytes back, offset being the next 2 bytes. The
+//    copy may overlap the bytes it produces, which encodes runs of a repeated byte.
+constexpr std::uint32_t min_match = 4;
+constexpr std::uint32_t max_match = 127 + min_match;
+constexpr std::uint32_t max_literals = 128;
+constexpr unsigned hash_bits = 10;
+
+//! Returns the compressed size, or 0 if the chunk cannot be compressed in less than capacity bytes.
+std::uint32_t compress_chunk(const std::uint8_t* in, std::uint32_t length, std::uint8_t* out, std::uint32_t capacity)
+{
+	std::uint16_t table[1 << hash_bits];
+	std::fill(std::begin(table), std::end(table), 0xffff);
+
+	std::uint32_t out_size = 0;
+	std::uint32_t literal_start = 0;
+
+	auto emit_literals = [&](std::uint32_t end) {
+		while (literal_start < end) {
+			std::uint32_t count = std::min(end - literal_start, max_literals);
+			if (out_size + 1 + count > capacity)
+				return false;
+			out[out_size++] = static_cast<std::uint8_t>(count - 1);
+			std::memcpy(out + out_size, in + literal_start, count);
+			out_size += count;
+			literal_start += count;
+		}
+		return true;
+	};
+
+	std::uint32_t i = 0;
+	while (i + min_match <= length) {
+		std::uint32_t word = read_at<std::uint32_t>(in + i);
+		std::uint32_t slot = (word * 2654435761u) >> (32 - hash_bits);
+		std::uint32_t candidate = table[slot];
+		table[slot] = static_cast<std::uint16_t>(i);
+
+		if (candidate == 0xffff || read_at<std::uint32_t>(in + candidate) != word) {
+			++i;
+			continue;
+		}
+
+		std::uint32_t match = min_match;
+		while (i + match < length && match < max_match && in[candidate + match] == in[i + match])
+			++match;
+
+		if (not emit_literals(i) || out_size + 3 > capacity)
+			return 0;
+
+		std::uint16_t offset = static_cast<std::uint16_t>(i - candidate);
+		out[out_size++] = static_cast<std::uint8_t>(0x80 | (match - min_match));
+		write_at(out + out_size, offset);
+		out_size += 2;
+
+		i += match;
+		literal_start = i;
+	}
+
+	if (not emit_literals(length))
+		return 0;
+
+	return out_size;
+}
+
+//! Returns false if the compressed data is corrupted.
+bool decompress_chunk(const std::uint8_t* in, std::uint32_t in_size, std::uint8_t* out, std::uint32_t length)
+{
+	std::uint32_t in_pos = 0;
+	std::uint32_t out_pos = 0;
+
+	while (in_pos < in_size) {
+		std::uint8_t control = in[in_pos++];
+
+		if (control & 0x80) {
+			if (in_pos + 2 > in_size)
+				return false;
+
+			std::uint32_t match = (control & 0x7f) + min_match;
+			std::uint32_t offset = read_at<std::uint16_t>(in + in_pos);
+			in_pos += 2;
+
+			if (offset == 0 || offset > out_pos || match > length - out_pos)
+				return false;
+
+			// Byte by byte, as the source may overlap the destination.
+			for (std::uint32_t i = 0; i < match; ++i, ++out_pos) {
+				out[out_pos] = out[out_pos - offset];
+			}
+		} else {
+			std::uint32_t count = control + 1u;
+			if (count > in_size - in_pos || count > length - out_pos)
+				return false;
+
+			std::memcpy(out + out_pos, in + in_pos, count);
+			in_pos += count;
+			out_pos += count;
+		}
+	}
+
+	return out_pos == length;
+}
+}
+
+constexpr std::uint32_t payload_store::chunk_size;
+
+std::string payload_store::store_file_name(const std::string& hardware_file_name)
+{
+	return hardware_file_name + ".payloads";
+}
+
+payload_store::payload_store(const std::uint8_t* base, std::uint64_t size)
+  : base_(base), size_(size), chunk_count_(0), chunk_table_offset_(0)
+{
+}
+
+payload_store::~payload_store()
+{
+	::munmap(const_cast<std::uint8_t*>(base_), size_);
+}
+
+std::shared_ptr<const payload_store> payload_store::open(const std::string& file_name)
+{
+	int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < header_size) {
+		::close(fd);
+		return nullptr;
+	}
+
+	void* base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (base == MAP_FAILED)
+		return nullptr;
+
+	// Payloads are decoded in whatever order the accesses are read.
+	::madvise(base, st.st_size, MADV_RANDOM);
+
+	std::shared_ptr<payload_store> store(new payload_store(static_cast<const std::uint8_t*>(base), st.st_size));
+
+	std::uint64_t magic = read_at<std::uint64_t>(store->base_);
+	std::uint32_t version = read_at<std::uint32_t>(store->base_ + 8);
+
+	if (magic != PAYLOAD_STORE_MAGIC) {
+		std::stringstream error_msg;
+
+		error_msg << "Magic number should be "
+		          << std::showbase << std::hex << PAYLOAD_STORE_MAGIC
+		          << " but is actually "
+		          << std::showbase <<  std::hex << magic;
+
+		throw std::runtime_error(error_msg.str());
+	} else if (version > PAYLOAD_STORE_VERSION) {
+		std::stringstream error_msg;
+
+		error_msg << "This version number is not handled: "
+		          << std::dec << version
+		          << ", expecting version "
+		          << std::dec << PAYLOAD_STORE_VERSION;
+
+		throw std::runtime_error(error_msg.str());
+	}
+
+	std::uint32_t stored_chunk_size = read_at<std::uint32_t>(store->base_ + 12);
+	store->chunk_count_ = read_at<std::uint64_t>(store->base_ + 16);
+	store->chunk_table_offset_ = read_at<std::uint64_t>(store->base_ + 24);
+
+	if (stored_chunk_size != chunk_size || store->chunk_table_offset_ < header_size ||
+	    store->chunk_table_offset_ > store->size_ ||
+	    (store->size_ - store->chunk_table_offset_) / chunk_entry_size < store->chunk_count_)
+		throw std::runtime_error("Malformed payload store: " + file_name);
+
+	return store;
+}
+
+bool payload_store::read(std::uint64_t reference, std::uint64_t length, std::uint8_t* destination) const
+{
+	if (length == 0)
+		return true;
+
+	std::uint64_t chunks = (length + chunk_size - 1) / chunk_size;
+
+	if (reference < header_size || reference > chunk_table_offset_ ||
+	    (chunk_table_offset_ - reference) / sizeof(std::uint32_t) < chunks)
+		return false;
+
+	const std::uint8_t* ids = base_ + reference;
+
+	for (std::uint64_t i = 0; i < chunks; ++i) {
+		std::uint32_t id = read_at<std::uint32_t>(ids + i * sizeof(std::uint32_t));
+		if (id >= chunk_count_)
+			return false;
+
+		const std::uint8_t* entry = base_ + chunk_table_offset_ + id * chunk_entry_size;
+		std::uint64_t offset = read_at<std::uint64_t>(entry);
+		std::uint32_t stored_size = read_at<std::uint32_t>(entry + 8);
+		std::uint32_t raw_size = read_at<std::uint32_t>(entry + 12);
+
+		std::uint64_t expected_size = std::min<std::uint64_t>(length - i * chunk_size, chunk_size);
+		if (raw_size != expected_size || offset > chunk_table_offset_ || stored_size > chunk_table_offset_ - offset)
+			return false;
+
+		std::uint8_t* chunk_destination = destination + i * chunk_size;
+
+		if (stored_size == raw_size)
+			std::memcpy(chunk_destination, base_ + offset, raw_size);
+		else if (not decompress_chunk(base_ + offset, stored_size, chunk_destination, raw_size))
+			return false;
+	}
+
+	return true;
+}
+
+bool payload_store::read(const std::vector<request>& requests, unsigned threads) const
+{
+	threads = effective_threads(threads);
+
+	// Spawning threads is only worth it for large amounts of data.
+	if (requests.size() < 2 * threads)
+		threads = 1;
+
+	std::atomic<bool> good(true);
+
+	auto decode = [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i) {
+			if (not read(requests[i].reference, requests[i].length, requests[i].destination))
+				good = false;
+		}
+	};
+
+	if (threads == 1)
+		decode(0, 0, requests.size());
+	else
+		for_each_slice(requests.size(), threads, decode);
+
+	return good;
+}
+
+payload_store_writer::payload_store_writer()
+  : fd_(-1), compression_(true), good_(false), written_(0), cache_(cache_size), payload_bytes_(0),
+    chunk_references_(0), stored_bytes_(0)
+{
+}
+
+payload_store_writer::~payload_store_writer()
+{
+	if (fd_ >= 0)
+		close();
+}
+
+bool payload_store_writer::open(const std::string& file_name)
+{
+	if (fd_ >= 0)
+		close();
+
+	fd_ = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd_ < 0)
+		return false;
+
+	good_ = true;
+	written_ = 0;
+	buffer_.clear();
+	buffer_.reserve(write_buffer_size);
+	chunks_.clear();
+	chunk_ids_.clear();
+	for (auto& cached : cache_) {
+		cached.data.clear();
+	}
+	payload_bytes_ = chunk_references_ = stored_bytes_ = 0;
+
+	// The chunk count and the table offset are filled when closing.
+	std::uint8_t header[header_size] = {};
+	write_at<std::uint64_t>(header, PAYLOAD_STORE_MAGIC);
+	write_at<std::uint32_t>(header + 8, PAYLOAD_STORE_VERSION);
+	write_at<std::uint32_t>(header + 12, payload_store::chunk_size);
+	write(header, header_size);
+
+	return true;
+}
+
+std::uint64_t payload_store_writer::add(const std::uint8_t* data, std::uint64_t length)
+{
+	if (length == 0)
+		return 0;
+
+	payload_bytes_ += length;
+
+	ids_.clear();
+	for (std::uint64_t offset = 0; offset < length; offset += payload_store::chunk_size) {
+		std::uint32_t size = static_cast<std::uint32_t>(std::min<std::uint64_t>(length - offset, payload_store::chunk_size));
+		ids_.push_back(add_chunk(data + offset, size));
+	}
+	chunk_references_ += ids_.size();
+
+	std::uint64_t reference = written_ + buffer_.size();
+	write(ids_.data(), ids_.size() * sizeof(std::uint32_t));
+
+	return reference;
+}
+
+std::uint32_t payload_store_writer::add_chunk(const std::uint8_t* data, std::uint32_t length)
+{
+	std::uint64_t hash = content_hash(data, length);
+
+	auto range = chunk_ids_.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (chunk_equals(it->second, hash, data, length))
+			return it->second;
+	}
+
+	if (chunks_.size() >= UINT32_MAX)
+		throw std::runtime_error("Too many distinct chunks in the payload store");
+
+	chunk new_chunk;
+	new_chunk.offset = written_ + buffer_.size();
+	new_chunk.raw_size = length;
+	new_chunk.stored_size = 0;
+
+	if (compression_) {
+		compressed_.resize(length);
+		new_chunk.stored_size = compress_chunk(data, length, compressed_.data(), length - 1);
+	}
+
+	if (new_chunk.stored_size != 0) {
+		write(compressed_.data(), new_chunk.stored_size);
+	} else {
+		new_chunk.stored_size = length;
+		write(data, length);
+	}
+	stored_bytes_ += new_chunk.stored_size;
+
+	std::uint32_t id = static_cast<std::uint32_t>(chunks_.size());
+	chunks_.push_back(new_chunk);
+	chunk_ids_.emplace(hash, id);
+
+	cached_chunk& cached = cache_[hash % cache_size];
+	cached.id = id;
+	cached.data.assign(data, data + length);
+
+	return id;
+}
+
+bool payload_store_writer::chunk_equals(std::uint32_t id, std::uint64_t hash, const std::uint8_t* data,
+                                        std::uint32_t length)
+{
+	if (chunks_[id].raw_size != length)
+		return false;
+
+	cached_chunk& cached = cache_[hash % cache_size];
+	if (cached.data.empty() || cached.id != id) {
+		cached.id = id;
+		read_chunk(id, cached.data);
+	}
+
+	return std::memcmp(cached.data.data(), data, length) == 0;
+}
+
+void payload_store_writer::read_chunk(std::uint32_t id, std::vector<std::uint8_t>& data)
+{
+	const chunk& stored = chunks_[id];
+
+	compressed_.resize(stored.stored_size);
+
+	if (stored.offset >= written_) {
+		std::memcpy(compressed_.data(), buffer_.data() + (stored.offset - written_), stored.stored_size);
+	} else if (::pread(fd_, compressed_.data(), stored.stored_size, stored.offset) !=
+	           static_cast<ssize_t>(stored.stored_size)) {
+		throw std::runtime_error("Could not read back the payload store");
+	}
+
+	data.resize(stored.raw_size);
+	if (stored.stored_size == stored.raw_size)
+		std::memcpy(data.data(), compressed_.data(), stored.raw_size);
+	else
+		decompress_chunk(compressed_.data(), stored.stored_size, data.data(), stored.raw_size);
+}
+
+void payload_store_writer::write(const void* data, std::uint64_t length)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	buffer_.insert(buffer_.end(), bytes, bytes + length);
+
+	if (buffer_.size() >= write_buffer_size)
+		flush();
+}
+
+void payload_store_writer::flush()
+{
+	std::size_t done = 0;
+	while (good_ && done < buffer_.size()) {
+		ssize_t result = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+		if (result <= 0)
+			good_ = false;
+		else
+			done += result;
+	}
+
+	written_ += buffer_.size();
+	buffer_.clear();
+}
+
+bool payload_store_writer::close()
+{
+	if (fd_ < 0)
+		return false;
+
+	std::uint64_t chunk_table_offset = written_ + buffer_.size();
+
+	for (const chunk& stored : chunks_) {
+		std::uint8_t entry[chunk_entry_size];
+		write_at(entry, stored.offset);
+		write_at(entry + 8, stored.stored_size);
+		write_at(entry + 12, stored.raw_size);
+		write(entry, chunk_entry_size);
+	}
+	flush();
+
+	std::uint8_t counts[16];
+	write_at<std::uint64_t>(counts, chunks_.size());
+	write_at(counts + 8, chunk_table_offset);
+	if (::pwrite(fd_, counts, sizeof(counts), 16) != static_cast<ssize_t>(sizeof(counts)))
+		good_ = false;
+
+	if (::close(fd_) != 0)
+		good_ = false;
+	fd_ = -1;
+
+	return good_;
+}
+}
+} // namespace reven::vmghost
@@ -0,0 +1,46 @@
+#include <sorted_hardware_file.h>
+
+#include <sstream>
+
+namespace reven {
+namespace vmghost {
+
+sorted_hardware_file::sorted_hardware_file(std::size_t window_size)
+  : window_size_(window_size), window_(window_size), position_(0)
+{
+}
+
+bool sorted_hardware_file::load(const std::string& file_name)
+{
+	window_ = reorder_window<hardware_access>(window_size_);
+	current_ = hardware_access();
+	position_ = 0;
+
+	return file_.load(file_name);
+}
+
+const hardware_access& sorted_hardware_file::next()
+{
+	while (not window_.full() && file_.next().valid()) {
+		if (not window_.push(file_.current())) {
+			std::stringstream error_msg;
+
+			error_msg << "Hardware access $" << std::dec << file_.position() << " is out of order by more than "
+			          << window_size_ << " accesses, the file must be reordered";
+
+			throw std::runtime_error(error_msg.str());
+		}
+	}
+
+	if (window_.empty()) {
+		current_.tsc = 0;
+		return current_;
+	}
+
+	current_ = window_.pop();
+	++position_;
+
+	return current_;
+}
+}
+} // namespace reven::vmghost
@@ -1,9 +1,11 @@
 #include <streamable_file.h>
 
+#include <sstream>
+
 namespace reven {
 namespace vmghost {
 
-streamable_file::streamable_file() : eof_(true)
+streamable_file::streamable_file() : eof_(true), opened_(false), max_container_size_(1ull << 30)
 {
 }
 
@@ -19,6 +21,19 @@ void streamable_file::load(const std::string& file_name)
 	check_eof();
 }
 
+void streamable_file::check_container_size(std::uint64_t count, std::uint64_t element_size) const
+{
+	if (count > max_container_size_ / element_size) {
+		std::stringstream error_msg;
+
+		error_msg << "Container of " << std::dec << count << " elements of " << element_size
+		          << " bytes exceeds the maximum size of "
+		          << max_container_size_ << " bytes";
+
+		throw std::runtime_error(error_msg.str());
+	}
+}
+
 void streamable_file::close()
 {
 	in_file_.close();
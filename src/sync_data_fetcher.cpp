@@ -0,0 +1,524 @@
+#include <sync_data_fetcher.h>
+#include <sync_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+//! Size of the first read at each offset, which holds the data of most sync points.
+constexpr std::uint64_t chunk_size = 4096;
+
+//! Same limit as streamable_file::max_container_size.
+constexpr std::uint64_t max_dump_size = 1ull << 30;
+
+template <typename T> T load(const std::uint8_t* bytes)
+{
+	T value;
+	std::memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+//! Bytes read after the dumps that do not fit in a chunk: enough for the end of the data, or the next header.
+constexpr std::uint64_t trailer_size = 4 + 16;
+
+//! What is left to read of the data at an offset.
+struct fetch_state {
+	//! Index of the offset.
+	std::size_t index;
+
+	//! Set if the dump below is being read, and the next read starts with its bytes. Otherwise, the next read starts
+	//! at a header.
+	bool is_dump;
+	sync_point_data_type type;
+	std::uint64_t dump_offset;
+	std::uint64_t length;
+};
+
+//! Parses the headers and dumps in [bytes, bytes + size), read at the specified file offset. at_end tells whether
+//! the file ends there. Returns false once all the data is parsed, true if next then describes the next read.
+template <typename Request>
+bool parse_data(const std::uint8_t* bytes, std::uint64_t size, std::uint64_t file_offset, bool at_end,
+                std::vector<sync_point_data>& data, blob_pool* pool, fetch_state& state, Request& next)
+{
+	std::uint64_t pos = 0;
+
+	while (true) {
+		if (pos + 4 + 16 > size) {
+			if (not at_end)
+				break;
+			if (pos + 4 <= size && load<std::uint32_t>(bytes + pos) != 0)
+				data.push_back({static_cast<sync_point_data_type>(load<std::uint32_t>(bytes + pos)), 0, {}});
+			return false;
+		}
+
+		auto type = static_cast<sync_point_data_type>(load<std::uint32_t>(bytes + pos));
+		if (type == sync_point_data_type::data_end)
+			return false;
+
+		std::uint64_t offset = load<std::uint64_t>(bytes + pos + 4);
+		std::uint64_t length = load<std::uint64_t>(bytes + pos + 12);
+		pos += 4 + 16;
+
+		if (length > max_dump_size) {
+			std::stringstream error_msg;
+
+			error_msg << "Container of " << std::dec << length << " elements of 1"
+			          << " bytes exceeds the maximum size of " << max_dump_size << " bytes";
+
+			throw std::runtime_error(error_msg.str());
+		}
+
+		if (pos + length > size && not at_end) {
+			// Read the rest of the dump in its own buffer, which then becomes the blob, and the next header with it.
+			std::uint64_t known = size - pos;
+
+			state.is_dump = true;
+			state.type = type;
+			state.dump_offset = offset;
+			state.length = length;
+
+			next.offset = file_offset + pos;
+			next.buffer.resize(length + trailer_size);
+			std::memcpy(next.buffer.data(), bytes + pos, known);
+			next.filled = known;
+			return true;
+		}
+
+		std::uint64_t available = std::min(length, size - pos);
+		std::vector<std::uint8_t> dump(bytes + pos, bytes + pos + available);
+
+		data.push_back({type, offset, pool ? pool->intern(std::move(dump)) : shared_blob(std::move(dump))});
+		pos += available;
+
+		if (available < length)
+			return false;
+	}
+
+	state.is_dump = false;
+	next.offset = file_offset + pos;
+	next.buffer.resize(chunk_size);
+	next.filled = 0;
+	return true;
+}
+
+std::runtime_error read_error(std::uint64_t offset, std::int64_t error)
+{
+	std::stringstream error_msg;
+
+	error_msg << "Cannot read the data file at " << std::showbase << std::hex << offset << ": "
+	          << std::strerror(static_cast<int>(-error));
+
+	return std::runtime_error(error_msg.str());
+}
+
+//! Reads the whole length, unless the file ends. Returns the number of bytes read, or -errno.
+std::int64_t pread_all(int fd, std::uint8_t* buffer, std::uint64_t length, std::uint64_t offset)
+{
+	std::uint64_t done = 0;
+
+	while (done < length) {
+		ssize_t result = ::pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result < 0)
+			return -errno;
+		if (result == 0)
+			break;
+		done += static_cast<std::uint64_t>(result);
+	}
+
+	return static_cast<std::int64_t>(done);
+}
+
+//! Reads what is not filled yet of the buffer of the request, and sets its result.
+template <typename Request> void read_rest(int fd, Request& r)
+{
+	std::int64_t read = 0;
+	if (r.filled < r.buffer.size())
+		read = pread_all(fd, r.buffer.data() + r.filled, r.buffer.size() - r.filled, r.offset + r.filled);
+
+	r.result = read < 0 ? read : static_cast<std::int64_t>(r.filled) + read;
+}
+}
+
+//! Submission and completion queues of an io_uring instance, used through the raw system calls.
+struct sync_data_fetcher::uring {
+	//! Returns nullptr if the kernel does not provide io_uring, or forbids it.
+	static std::unique_ptr<uring> create(unsigned entries)
+	{
+		std::unique_ptr<uring> ring(new uring());
+
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+
+		ring->fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+		if (ring->fd < 0)
+			return nullptr;
+
+		ring->entries = params.sq_entries;
+
+		ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+		ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		// Since Linux 5.4, both queues share a single mapping.
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+
+		ring->sq_ptr = ::mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+		                      IORING_OFF_SQ_RING);
+		if (ring->sq_ptr == MAP_FAILED) {
+			ring->sq_ptr = nullptr;
+			return nullptr;
+		}
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP) {
+			ring->cq_ptr = ring->sq_ptr;
+		} else {
+			ring->cq_ptr = ::mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			                      ring->fd, IORING_OFF_CQ_RING);
+			if (ring->cq_ptr == MAP_FAILED) {
+				ring->cq_ptr = nullptr;
+				return nullptr;
+			}
+		}
+
+		ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = ::mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+		                    IORING_OFF_SQES);
+		if (sqes == MAP_FAILED)
+			return nullptr;
+		ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+		auto sq = static_cast<std::uint8_t*>(ring->sq_ptr);
+		ring->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		ring->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+		auto cq = static_cast<std::uint8_t*>(ring->cq_ptr);
+		ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		ring->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		return ring;
+	}
+
+	~uring()
+	{
+		if (sqes)
+			::munmap(sqes, sqes_size);
+		if (cq_ptr && cq_ptr != sq_ptr)
+			::munmap(cq_ptr, cq_size);
+		if (sq_ptr)
+			::munmap(sq_ptr, sq_size);
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	//! Reads the requests from file_fd, at most entries at a time. Requests that io_uring fails, e.g. on kernels
+	//! before 5.6 without IORING_OP_READ, are read again with pread.
+	void read(std::vector<request>& requests, int file_fd)
+	{
+		std::size_t submitted = 0;
+		std::size_t completed = 0;
+		unsigned unsubmitted = 0;
+
+		while (completed < requests.size()) {
+			unsigned tail = *sq_tail;
+			unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+			while (submitted < requests.size() && submitted - completed < entries && tail - head < entries) {
+				request& r = requests[submitted];
+				unsigned index = tail & *sq_mask;
+
+				io_uring_sqe& sqe = sqes[index];
+				std::memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = IORING_OP_READ;
+				sqe.fd = file_fd;
+				sqe.addr = reinterpret_cast<std::uint64_t>(r.buffer.data() + r.filled);
+				sqe.len = static_cast<std::uint32_t>(r.buffer.size() - r.filled);
+				sqe.off = r.offset + r.filled;
+				sqe.user_data = submitted;
+
+				sq_array[index] = index;
+				++tail;
+				++submitted;
+				++unsubmitted;
+			}
+
+			__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+			long result = ::syscall(__NR_io_uring_enter, fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if (result < 0) {
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+					continue;
+				throw read_error(requests[completed].offset, -errno);
+			}
+			unsubmitted -= static_cast<unsigned>(result);
+
+			unsigned cq_position = *cq_head;
+			unsigned cq_end = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+			for (; cq_position != cq_end; ++cq_position) {
+				const io_uring_cqe& cqe = cqes[cq_position & *cq_mask];
+				request& r = requests[cqe.user_data];
+
+				// Short reads are only expected at the end of the file: complete them to tell both apart.
+				if (cqe.res >= 0)
+					r.filled += static_cast<std::uint64_t>(cqe.res);
+				read_rest(file_fd, r);
+
+				++completed;
+			}
+
+			__atomic_store_n(cq_head, cq_position, __ATOMIC_RELEASE);
+		}
+	}
+
+	int fd = -1;
+	unsigned entries = 0;
+
+	void* sq_ptr = nullptr;
+	std::size_t sq_size = 0;
+	void* cq_ptr = nullptr;
+	std::size_t cq_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	std::size_t sqes_size = 0;
+
+	unsigned* sq_head = nullptr;
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_mask = nullptr;
+	unsigned* sq_array = nullptr;
+
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	unsigned* cq_mask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+};
+
+//! Threads reading the requests of a batch with pread, as many in flight as there are threads.
+struct sync_data_fetcher::pread_pool {
+	pread_pool(unsigned threads, int file_fd)
+	  : fd(file_fd), requests(nullptr), next(0), finished(0), active(0), generation(0), stopping(false)
+	{
+		for (unsigned i = 0; i < threads; ++i)
+			workers.emplace_back(&pread_pool::work, this);
+	}
+
+	~pread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		batch_ready.notify_all();
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	void read(std::vector<request>& batch)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		requests = &batch;
+		next = 0;
+		finished = 0;
+		++generation;
+		batch_ready.notify_all();
+
+		// Wait for the workers to leave the batch too, so that none of them takes a request of the next one.
+		batch_done.wait(lock, [this]() { return finished == requests->size() && active == 0; });
+		requests = nullptr;
+	}
+
+	void work()
+	{
+		std::uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+			batch_ready.wait(lock, [this, seen]() { return stopping || (requests && generation != seen); });
+			if (stopping)
+				return;
+
+			seen = generation;
+			std::vector<request>& batch = *requests;
+			++active;
+			lock.unlock();
+
+			std::size_t done = 0;
+			for (std::size_t i = next++; i < batch.size(); i = next++) {
+				read_rest(fd, batch[i]);
+				++done;
+			}
+
+			lock.lock();
+			finished += done;
+			--active;
+			if (finished == batch.size() && active == 0)
+				batch_done.notify_all();
+		}
+	}
+
+	int fd;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable batch_ready;
+	std::condition_variable batch_done;
+
+	std::vector<request>* requests;
+	std::atomic<std::size_t> next;
+	std::size_t finished;
+	unsigned active;
+	std::uint64_t generation;
+	bool stopping;
+};
+
+sync_data_fetcher::sync_data_fetcher(const std::string& data_file_name, unsigned queue_depth, backend requested)
+  : fd_(-1), queue_depth_(std::max(queue_depth, 1u)), backend_(requested)
+{
+	int fd = ::open(data_file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	std::uint64_t magic = 0;
+	if (pread_all(fd, reinterpret_cast<std::uint8_t*>(&magic), sizeof(magic), 0) != sizeof(magic) ||
+	    magic != SYNC_POINT_DATA_MAGIC) {
+		::close(fd);
+		return;
+	}
+	fd_ = fd;
+
+	if (backend_ != backend::thread_pool) {
+		uring_ = uring::create(queue_depth_);
+
+		if (uring_) {
+			backend_ = backend::io_uring;
+		} else if (backend_ == backend::io_uring) {
+			::close(fd_);
+			fd_ = -1;
+			throw std::runtime_error("io_uring is not available");
+		}
+	}
+
+	if (not uring_) {
+		backend_ = backend::thread_pool;
+
+		// Each thread has one read in flight, but there is no point in hundreds of them.
+		pool_.reset(new pread_pool(std::min(queue_depth_, 32u), fd_));
+	}
+}
+
+sync_data_fetcher::~sync_data_fetcher()
+{
+	uring_.reset();
+	pool_.reset();
+
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+std::vector<std::vector<sync_point_data>> sync_data_fetcher::fetch(const std::vector<std::uint32_t>& offsets,
+                                                                   blob_pool* pool)
+{
+	std::vector<std::vector<sync_point_data>> data(offsets.size());
+
+	if (fd_ < 0)
+		return data;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// The reads of a round, and what each of them is for.
+	std::vector<fetch_state> states;
+	std::vector<request> requests;
+
+	for (std::size_t i = 0; i < offsets.size(); ++i) {
+		if (offsets[i] == 0)
+			continue;
+		states.push_back({i, false, sync_point_data_type::data_end, 0, 0});
+		requests.push_back({offsets[i], std::vector<std::uint8_t>(chunk_size), 0, 0});
+	}
+
+	while (not requests.empty()) {
+		read(requests);
+
+		std::size_t kept = 0;
+
+		for (std::size_t i = 0; i < requests.size(); ++i) {
+			request& r = requests[i];
+			fetch_state& state = states[i];
+			std::vector<sync_point_data>& result = data[state.index];
+
+			if (r.result < 0)
+				throw read_error(r.offset, r.result);
+
+			std::uint64_t size = static_cast<std::uint64_t>(r.result);
+			bool at_end = size < r.buffer.size();
+
+			const std::uint8_t* bytes = r.buffer.data();
+			std::uint64_t file_offset = r.offset;
+			std::uint8_t trailer[trailer_size];
+
+			if (state.is_dump) {
+				std::uint64_t available = std::min(size, state.length);
+
+				// Keep what follows the dump aside, and hand the buffer over to the dump.
+				std::memcpy(trailer, bytes + available, size - available);
+
+				r.buffer.resize(available);
+				result.push_back({state.type, state.dump_offset,
+				                  pool ? pool->intern(std::move(r.buffer)) : shared_blob(std::move(r.buffer))});
+
+				if (available < state.length)
+					continue;
+
+				bytes = trailer;
+				size -= available;
+				file_offset += available;
+			}
+
+			request next{0, {}, 0, 0};
+			if (parse_data(bytes, size, file_offset, at_end, result, pool, state, next)) {
+				states[kept] = state;
+				requests[kept] = std::move(next);
+				++kept;
+			}
+		}
+
+		states.resize(kept);
+		requests.resize(kept);
+	}
+
+	return data;
+}
+
+void sync_data_fetcher::read(std::vector<request>& requests)
+{
+	if (uring_)
+		uring_->read(requests, fd_);
+	else
+		pool_->read(requests);
+}
+}
+} // namespace reven::vmghost
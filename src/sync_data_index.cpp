@@ -0,0 +1,219 @@
+#include <index_header.h>
+#include <sync_data_index.h>
+#include <sync_file.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+bool space_page_order(const sync_data_index::entry& lhs, const sync_data_index::entry& rhs)
+{
+	if (lhs.space != rhs.space)
+		return lhs.space < rhs.space;
+	if (lhs.page != rhs.page)
+		return lhs.page < rhs.page;
+	if (lhs.position != rhs.position)
+		return lhs.position < rhs.position;
+	return lhs.data_offset < rhs.data_offset;
+}
+
+bool position_order(const sync_data_index::entry& lhs, const sync_data_index::entry& rhs)
+{
+	return lhs.position < rhs.position || (lhs.position == rhs.position && lhs.data_offset < rhs.data_offset);
+}
+}
+
+constexpr unsigned sync_data_index::page_shift;
+
+std::string sync_data_index::index_file_name(const std::string& data_file_name)
+{
+	return data_file_name + ".dumps";
+}
+
+bool sync_data_index::read_dump(streamable_file& data_file, std::uint64_t data_offset, sync_point_data& dump)
+{
+	data_file.seek(data_offset);
+
+	std::uint32_t data_type;
+	data_file >> data_type;
+
+	dump.type = static_cast<sync_point_data_type>(data_type);
+	if (data_file.eof() || dump.type == sync_point_data_type::data_end)
+		return false;
+
+	data_file >> dump.offset >> dump.data;
+
+	return not data_file.eof() || dump.data.empty();
+}
+
+bool sync_data_index::build(const std::string& sync_file_name, const std::string& data_file_name)
+{
+	entries_.clear();
+	sync_file_name_ = sync_file_name;
+	data_file_name_ = data_file_name;
+
+	if (not file_stamp::of(sync_file_name, sync_stamp_) || not file_stamp::of(data_file_name, data_stamp_))
+		return false;
+
+	// The sync file only gives the offsets of the data, which is read here without its payloads.
+	sync_file sync;
+	if (not sync.load(sync_file_name, ""))
+		return false;
+
+	streamable_file data_file;
+	data_file.load(data_file_name);
+
+	if (data_file.eof() || !data_file.is_open())
+		return false;
+
+	std::uint64_t magic;
+	data_file >> magic;
+
+	if (data_file.eof()) {
+		return false;
+	} else if (magic != SYNC_POINT_DATA_MAGIC) {
+		std::stringstream error_msg;
+
+		error_msg << "Magic number for the data file should be "
+		          << std::showbase << std::hex << SYNC_POINT_DATA_MAGIC
+		          << " but is actually "
+		          << std::showbase <<  std::hex << magic;
+
+		throw std::runtime_error(error_msg.str());
+	}
+
+	while (sync.next().valid()) {
+		if (sync.data_offset() == 0)
+			continue;
+
+		data_file.seek(sync.data_offset());
+
+		while (true) {
+			std::uint64_t data_offset = data_file.pos();
+			std::uint32_t data_type;
+			std::uint64_t address;
+			std::uint64_t length;
+
+			data_file >> data_type;
+			if (data_file.eof() || data_type == sync_point_data_type::data_end)
+				break;
+
+			data_file >> address >> length;
+			if (data_file.eof())
+				break;
+
+			data_file.skip(length);
+
+			length = std::min(length, UINT64_MAX - address);
+			if (length == 0)
+				continue;
+
+			std::uint64_t first_page = address >> page_shift;
+			std::uint64_t last_page = (address + length - 1) >> page_shift;
+
+			for (std::uint64_t page = first_page; page <= last_page; ++page) {
+				entries_.push_back({data_type, page, sync.position(), data_offset, address, length});
+			}
+		}
+	}
+
+	std::sort(entries_.begin(), entries_.end(), space_page_order);
+
+	return true;
+}
+
+bool sync_data_index::load(const std::string& sync_file_name, const std::string& data_file_name)
+{
+	entries_.clear();
+	sync_file_name_ = sync_file_name;
+	data_file_name_ = data_file_name;
+
+	file_stamp current_data_stamp;
+	file_stamp current_sync_stamp;
+	if (not file_stamp::of(data_file_name, current_data_stamp) ||
+	    not file_stamp::of(sync_file_name, current_sync_stamp))
+		return false;
+
+	streamable_file file;
+	file.load(index_file_name(data_file_name));
+
+	// Indexed against another sync file.
+	if (not read_index_header(file, SYNC_DATA_INDEX_MAGIC, SYNC_DATA_INDEX_VERSION, current_data_stamp) ||
+	    not read_indexed_file(file, sync_file_name, current_sync_stamp))
+		return false;
+
+	data_stamp_ = current_data_stamp;
+	sync_stamp_ = current_sync_stamp;
+	return read_index_vector(file, entries_);
+}
+
+bool sync_data_index::save() const
+{
+	streamable_outfile out;
+	out.open(index_file_name(data_file_name_));
+
+	if (not out.is_open())
+		return false;
+
+	write_index_header(out, SYNC_DATA_INDEX_MAGIC, SYNC_DATA_INDEX_VERSION, data_stamp_);
+	write_indexed_file(out, sync_file_name_, sync_stamp_);
+	write_index_vector(out, entries_);
+	out.close();
+
+	return out.good();
+}
+
+bool sync_data_index::load_or_build(const std::string& sync_file_name, const std::string& data_file_name)
+{
+	if (load(sync_file_name, data_file_name))
+		return true;
+
+	if (not build(sync_file_name, data_file_name))
+		return false;
+
+	// The index is still usable if it cannot be saved, e.g. in a read-only directory.
+	save();
+	return true;
+}
+
+std::vector<sync_data_index::entry> sync_data_index::query(sync_point_data_type space, std::uint64_t address,
+                                                           std::uint64_t length) const
+{
+	std::vector<entry> result;
+
+	length = std::min(length, UINT64_MAX - address);
+
+	std::uint64_t first_page = address >> page_shift;
+	std::uint64_t last_page = first_page;
+	if (length > 0)
+		last_page = (address + length - 1) >> page_shift;
+
+	entry first_key = {static_cast<std::uint64_t>(space), first_page, 0, 0, 0, 0};
+	entry last_key = {static_cast<std::uint64_t>(space), last_page, UINT64_MAX, UINT64_MAX, 0, 0};
+
+	auto first = std::lower_bound(entries_.begin(), entries_.end(), first_key, space_page_order);
+	auto last = std::upper_bound(first, entries_.end(), last_key, space_page_order);
+
+	// Pages are coarser than dumps: keep the dumps that overlap the range itself.
+	std::uint64_t end = address + std::max<std::uint64_t>(length, 1);
+	std::copy_if(first, last, std::back_inserter(result),
+	             [address, end](const entry& e) { return e.address < end && e.address + e.length > address; });
+
+	// Keep a single result per dump, the one for its first page in the range.
+	std::stable_sort(result.begin(), result.end(), position_order);
+	result.erase(std::unique(result.begin(), result.end(),
+	                         [](const entry& lhs, const entry& rhs) {
+		                         return lhs.position == rhs.position && lhs.data_offset == rhs.data_offset;
+	                         }),
+	             result.end());
+
+	return result;
+}
+}
+} // namespace reven::vmghost
@@ -1,12 +1,79 @@
 #include <sync_point.h>
 #include <sync_event.h>
 
+#include <cstddef>
+#include <cstring>
 #include <ostream>
 #include <iomanip>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace reven {
 namespace vmghost {
 
+namespace {
+
+using context = sync_event::context;
+
+static_assert(offsetof(context, cr4) - offsetof(context, rax) == (context::register_count - 1) * sizeof(std::uint64_t),
+              "The registers of a context must be contiguous");
+
+const char* const register_names[context::register_count] = {
+	"RAX", "RBX", "RCX", "RDX", "RSI", "RDI", "RBP", "RSP", "R8",  "R9",
+	"R10", "R11", "R12", "R13", "R14", "R15", "CR0", "CR2", "CR3", "CR4",
+};
+
+const std::uint8_t* registers_of(const context& c)
+{
+	return reinterpret_cast<const std::uint8_t*>(&c) + offsetof(context, rax);
+}
+
+//! Mask of the registers that differ between lhs and rhs, compared 4 (AVX2) or 2 (SSE2) at a time.
+std::uint32_t differing_register_values(const context& lhs, const context& rhs)
+{
+	const std::uint8_t* left = registers_of(lhs);
+	const std::uint8_t* right = registers_of(rhs);
+	std::uint32_t equal = 0;
+
+#if defined(__AVX2__)
+	for (unsigned i = 0; i < context::register_count; i += 4) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i * sizeof(std::uint64_t)));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i * sizeof(std::uint64_t)));
+
+		__m256i same = _mm256_cmpeq_epi64(a, b);
+		equal |= static_cast<std::uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(same))) << i;
+	}
+#elif defined(__SSE2__)
+	for (unsigned i = 0; i < context::register_count; i += 2) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i * sizeof(std::uint64_t)));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i * sizeof(std::uint64_t)));
+
+		// SSE2 only compares 32 bits lanes: a register is equal if both its halves are.
+		__m128i same_halves = _mm_cmpeq_epi32(a, b);
+		__m128i same = _mm_and_si128(same_halves, _mm_shuffle_epi32(same_halves, _MM_SHUFFLE(2, 3, 0, 1)));
+		equal |= static_cast<std::uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(same))) << i;
+	}
+#else
+	for (unsigned i = 0; i < context::register_count; ++i) {
+		if (std::memcmp(left + i * sizeof(std::uint64_t), right + i * sizeof(std::uint64_t), sizeof(std::uint64_t)) == 0)
+			equal |= 1u << i;
+	}
+#endif
+
+	return ~equal & context::registers_mask;
+}
+}
+
+constexpr unsigned sync_event::context::register_count;
+constexpr std::uint32_t sync_event::context::fpu_sw_bit;
+constexpr std::uint32_t sync_event::context::fpu_cw_bit;
+constexpr std::uint32_t sync_event::context::fpu_tags_bit;
+constexpr std::uint32_t sync_event::context::registers_mask;
+
 std::ostream& operator<<(std::ostream& out, const sync_event& event)
 {
 	if (!event.is_valid) {
@@ -20,28 +87,11 @@ std::ostream& operator<<(std::ostream& out, const sync_event& event)
 	out << std::setfill('0');
 	if (!event.is_first_event_context_unknown) {
 		out << "RIP=" << std::setw(16) << event.start_rip
-		    << " RFL=" << std::setw(16) << event.rflags // 22 useful bits only
-		    << " RAX=" << std::setw(16) << event.start_context.rax
-		    << " RBX=" << std::setw(16) << event.start_context.rbx
-		    << " RCX=" << std::setw(16) << event.start_context.rcx
-		    << " RDX=" << std::setw(16) << event.start_context.rdx
-		    << " RSI=" << std::setw(16) << event.start_context.rsi
-		    << " RDI=" << std::setw(16) << event.start_context.rdi
-		    << " RBP=" << std::setw(16) << event.start_context.rbp
-		    << " RSP=" << std::setw(16) << event.start_context.rsp
-		    << " R8=" << std::setw(16) << event.start_context.r8
-		    << " R9=" << std::setw(16) << event.start_context.r9
-		    << " R10=" << std::setw(16) << event.start_context.r10
-		    << " R11=" << std::setw(16) << event.start_context.r11
-		    << " R12=" << std::setw(16) << event.start_context.r12
-		    << " R13=" << std::setw(16) << event.start_context.r13
-		    << " R14=" << std::setw(16) << event.start_context.r14
-		    << " R15=" << std::setw(16) << event.start_context.r15
-		    << " CR0=" << std::setw(16) << event.start_context.cr0
-		    << " CR2=" << std::setw(16) << event.start_context.cr2
-		    << " CR3=" << std::setw(16) << event.start_context.cr3
-		    << " CR4=" << std::setw(16) << event.start_context.cr4
-		    << " FSW=" << std::setw(4) << event.start_context.fpu_sw
+		    << " RFL=" << std::setw(16) << event.rflags; // 22 useful bits only
+		for (unsigned i = 0; i < context::register_count; ++i) {
+			out << ' ' << context::register_name(i) << '=' << std::setw(16) << event.start_context.register_value(i);
+		}
+		out << " FSW=" << std::setw(4) << event.start_context.fpu_sw
 		    << " FCW=" << std::setw(4) << event.start_context.fpu_cw
 		    << " FTAGS=" << std::setw(2) << +event.start_context.fpu_tags // force 8bit as number
 		    << " TSC=" << std::setw(16) << event.start_context.tsc;
@@ -67,34 +117,22 @@ std::ostream& operator<<(std::ostream& out, const sync_event& event)
 	} else {
 		out << "New context " << (event.is_instruction_emulation ? "emulated" : "to check") << " :";
 
-#define COMPARE_AND_DISPLAY(reg, name, size)                                                                                          \
-	if (event.is_first_event_context_unknown || event.new_context.reg != event.start_context.reg)                      \
-		out << " " name "=" << std::setw(size) << +event.new_context.reg;
-
-		COMPARE_AND_DISPLAY(rax, "RAX", 16);
-		COMPARE_AND_DISPLAY(rbx, "RBX", 16);
-		COMPARE_AND_DISPLAY(rcx, "RCX", 16);
-		COMPARE_AND_DISPLAY(rdx, "RDX", 16);
-		COMPARE_AND_DISPLAY(rsi, "RSI", 16);
-		COMPARE_AND_DISPLAY(rdi, "RDI", 16);
-		COMPARE_AND_DISPLAY(rbp, "RBP", 16);
-		COMPARE_AND_DISPLAY(rsp, "RSP", 16);
-		COMPARE_AND_DISPLAY(r8, "R8", 16);
-		COMPARE_AND_DISPLAY(r9, "R9", 16);
-		COMPARE_AND_DISPLAY(r10, "R10", 16);
-		COMPARE_AND_DISPLAY(r11, "R11", 16);
-		COMPARE_AND_DISPLAY(r12, "R12", 16);
-		COMPARE_AND_DISPLAY(r13, "R13", 16);
-		COMPARE_AND_DISPLAY(r14, "R14", 16);
-		COMPARE_AND_DISPLAY(r15, "R15", 16);
-		COMPARE_AND_DISPLAY(cr0, "CR0", 16);
-		COMPARE_AND_DISPLAY(cr2, "CR2", 16);
-		COMPARE_AND_DISPLAY(cr3, "CR3", 16);
-		COMPARE_AND_DISPLAY(cr4, "CR4", 16);
-		COMPARE_AND_DISPLAY(fpu_sw, "FSW", 4);
-		COMPARE_AND_DISPLAY(fpu_cw, "FCW", 4);
-		COMPARE_AND_DISPLAY(fpu_tags, "FTAGS", 2);
-		COMPARE_AND_DISPLAY(tsc, "TSC", 16);
+		std::uint32_t changed = event.is_first_event_context_unknown
+		                          ? ~0u
+		                          : event.new_context.differing_registers(event.start_context);
+
+		for (unsigned i = 0; i < context::register_count; ++i) {
+			if (changed & (1u << i))
+				out << ' ' << context::register_name(i) << '=' << std::setw(16) << event.new_context.register_value(i);
+		}
+		if (changed & context::fpu_sw_bit)
+			out << " FSW=" << std::setw(4) << event.new_context.fpu_sw;
+		if (changed & context::fpu_cw_bit)
+			out << " FCW=" << std::setw(4) << event.new_context.fpu_cw;
+		if (changed & context::fpu_tags_bit)
+			out << " FTAGS=" << std::setw(2) << +event.new_context.fpu_tags;
+		if (event.is_first_event_context_unknown || event.new_context.tsc != event.start_context.tsc)
+			out << " TSC=" << std::setw(16) << event.new_context.tsc;
 	}
 
 	out << std::endl;
@@ -104,22 +142,42 @@ std::ostream& operator<<(std::ostream& out, const sync_event& event)
 	return out;
 }
 
-bool sync_event::context::are_values_equivalent(const context& other) const
+const char* sync_event::context::register_name(unsigned index)
 {
-	return rax == other.rax && rbx == other.rbx && rcx == other.rcx && rdx == other.rdx && rsi == other.rsi &&
-	       rdi == other.rdi && rbp == other.rbp && rsp == other.rsp && r8 == other.r8 && r9 == other.r9 &&
-	       r10 == other.r10 && r11 == other.r11 && r12 == other.r12 && r13 == other.r13 && r14 == other.r14 &&
-	       r15 == other.r15 && cr0 == other.cr0 && cr2 == other.cr2 && cr3 == other.cr3 && cr4 == other.cr4;
+	return register_names[index];
 }
 
-#ifdef RVN_MACHINES_DEBUG_SYNC
-#define CHECK_REG_VALIDITY(reg)                                                                                        \
-	if (start_context.reg != new_context.reg) {                                                                        \
-		throw std::runtime_error("Unforseen context change in reg");                                                   \
-	}
-#else
-#define CHECK_REG_VALIDITY(reg)
-#endif
+std::uint64_t sync_event::context::register_value(unsigned index) const
+{
+	std::uint64_t value;
+	std::memcpy(&value, registers_of(*this) + index * sizeof(value), sizeof(value));
+	return value;
+}
+
+void sync_event::context::set_register_value(unsigned index, std::uint64_t value)
+{
+	std::memcpy(reinterpret_cast<std::uint8_t*>(this) + offsetof(context, rax) + index * sizeof(value), &value,
+	            sizeof(value));
+}
+
+std::uint32_t sync_event::context::differing_registers(const context& other) const
+{
+	std::uint32_t mask = differing_register_values(*this, other);
+
+	if (fpu_sw != other.fpu_sw)
+		mask |= fpu_sw_bit;
+	if (fpu_cw != other.fpu_cw)
+		mask |= fpu_cw_bit;
+	if (fpu_tags != other.fpu_tags)
+		mask |= fpu_tags_bit;
+
+	return mask;
+}
+
+bool sync_event::context::are_values_equivalent(const context& other) const
+{
+	return differing_register_values(*this, other) == 0;
+}
 
 void sync_event::check_sanity()
 {
@@ -134,28 +192,17 @@ void sync_event::check_sanity()
 			throw std::runtime_error("CPU Fault that should wait doesn't make sense");
 		}
 	}
-	if (!is_instruction_emulation) {
-		CHECK_REG_VALIDITY(rax);
-		CHECK_REG_VALIDITY(rbx);
-		CHECK_REG_VALIDITY(rcx);
-		CHECK_REG_VALIDITY(rdx);
-		CHECK_REG_VALIDITY(rsi);
-		CHECK_REG_VALIDITY(rdi);
-		CHECK_REG_VALIDITY(rbp);
-		CHECK_REG_VALIDITY(rsp);
-		CHECK_REG_VALIDITY(r8);
-		CHECK_REG_VALIDITY(r9);
-		CHECK_REG_VALIDITY(r10);
-		CHECK_REG_VALIDITY(r11);
-		CHECK_REG_VALIDITY(r12);
-		CHECK_REG_VALIDITY(r13);
-		CHECK_REG_VALIDITY(r14);
-		CHECK_REG_VALIDITY(r15);
-		CHECK_REG_VALIDITY(rip);
-		CHECK_REG_VALIDITY(cr0);
-		CHECK_REG_VALIDITY(cr2);
-		CHECK_REG_VALIDITY(cr3);
+
+#ifdef RVN_MACHINES_DEBUG_SYNC
+	// Without emulation, nothing but CR4 may change.
+	std::uint32_t changed = new_context.differing_registers(start_context) & context::registers_mask &
+	                        ~(1u << (context::register_count - 1));
+
+	if (!is_instruction_emulation && changed != 0) {
+		throw std::runtime_error(std::string("Unforseen context change in ") +
+		                         context::register_name(__builtin_ctz(changed)));
 	}
+#endif
 }
 
 
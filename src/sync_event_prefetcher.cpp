@@ -0,0 +1,185 @@
+#include <sync_event_prefetcher.h>
+
+#include <chrono>
+
+namespace reven {
+namespace vmghost {
+
+namespace {
+
+//! Number of times a thread checks the ring again before going to sleep.
+constexpr unsigned spin_count = 64;
+
+//! Sleeping threads check the ring again after this delay, even if they were not woken up.
+constexpr std::chrono::milliseconds sleep_timeout(1);
+}
+
+sync_event_prefetcher::sync_event_prefetcher(const std::string& file_name, const std::string& data_file_name,
+                                             std::size_t capacity, std::shared_ptr<blob_pool> pool)
+  : file_(file_name, data_file_name), valid_(file_.is_valid()), ring_(capacity ? capacity : 1), holding_front_(false),
+    ended_(false), stopping_(false), consumer_waiting_(false), producer_waiting_(false)
+{
+	file_.set_blob_pool(std::move(pool));
+
+	if (valid_)
+		start(false, 0);
+}
+
+sync_event_prefetcher::~sync_event_prefetcher()
+{
+	stop();
+}
+
+const sync_event* sync_event_prefetcher::next()
+{
+	if (!valid_)
+		return nullptr;
+
+	if (holding_front_) {
+		holding_front_ = false;
+		ring_.pop();
+		notify(producer_waiting_);
+	}
+
+	if (ended_)
+		return nullptr;
+
+	wait(consumer_waiting_, [this]() { return ring_.front() != nullptr; });
+
+	slot& front = *ring_.front();
+
+	if (front.error || front.is_end) {
+		std::exception_ptr error = front.error;
+
+		ended_ = true;
+		ring_.pop();
+
+		if (error)
+			std::rethrow_exception(error);
+		return nullptr;
+	}
+
+	holding_front_ = true;
+	return &front.event;
+}
+
+void sync_event_prefetcher::advance_to(std::uint64_t position)
+{
+	if (!valid_)
+		return;
+
+	stop();
+	start(true, position);
+}
+
+std::size_t sync_event_prefetcher::ready() const
+{
+	// The slot held by the consumer is only popped by the next call to next.
+	return ring_.size() - (holding_front_ ? 1 : 0);
+}
+
+void sync_event_prefetcher::start(bool seek, std::uint64_t position)
+{
+	thread_ = std::thread(&sync_event_prefetcher::produce, this, seek, position);
+}
+
+void sync_event_prefetcher::stop()
+{
+	if (!thread_.joinable())
+		return;
+
+	stopping_ = true;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		changed_.notify_all();
+	}
+	thread_.join();
+	stopping_ = false;
+
+	ring_.clear();
+	holding_front_ = false;
+	ended_ = false;
+}
+
+void sync_event_prefetcher::produce(bool seek, std::uint64_t position)
+{
+	try {
+		// Position 0 is before the first event: restart the reading as from the constructor, without the event cached
+		// by the file before the seek.
+		if (seek && position == 0) {
+			file_.seek_point(0);
+		} else if (seek) {
+			file_.advance_to(position);
+
+			const sync_event& event = file_.current_event();
+			if (event.is_valid && !push(&event, nullptr))
+				return;
+		}
+
+		// At the end of the file, next may keep returning the last sync point: stop at eof. This and stopping at the
+		// first invalid event are the differences with the usual loop, see the class documentation.
+		while (!file_.eof() && file_.next().valid()) {
+			const sync_event& event = file_.current_event();
+			if (!event.is_valid)
+				break;
+
+			if (!push(&event, nullptr))
+				return;
+		}
+
+		push(nullptr, nullptr);
+	} catch (...) {
+		push(nullptr, std::current_exception());
+	}
+}
+
+bool sync_event_prefetcher::push(const sync_event* event, std::exception_ptr error)
+{
+	wait(producer_waiting_, [this]() { return stopping_ || ring_.back() != nullptr; });
+
+	if (stopping_)
+		return false;
+
+	slot& back = *ring_.back();
+
+	if (event)
+		back.event = *event;
+	back.error = std::move(error);
+	back.is_end = !event;
+
+	ring_.push();
+	notify(consumer_waiting_);
+	return true;
+}
+
+template <typename F> void sync_event_prefetcher::wait(std::atomic<bool>& waiting, F ready)
+{
+	for (unsigned i = 0; i < spin_count; ++i) {
+		if (ready())
+			return;
+		std::this_thread::yield();
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	// Either the other side sees the flag after changing the ring, or the ring is seen changed here.
+	waiting = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	while (!ready())
+		changed_.wait_for(lock, sleep_timeout);
+
+	waiting = false;
+}
+
+void sync_event_prefetcher::notify(std::atomic<bool>& waiting)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (waiting) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		changed_.notify_all();
+	}
+}
+}
+} // namespace reven::vmghost
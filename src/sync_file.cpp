@@ -4,13 +4,19 @@
 
 #include <sync_file.h>
 #include <sstream>
+#include <unordered_set>
 
 #define HEADER_SIZE 1024
 
+// Offset of the data offset in the records of the versions up to 2, and of the version 3
+#define DATA_OFFSET_FIELD_V2 68
+#define DATA_OFFSET_FIELD_V3 188
+
 namespace reven {
 namespace vmghost {
 
-sync_file::sync_file() : position_(0), last_valid_position_(0), sync_point_count_(0)
+sync_file::sync_file()
+  : position_(0), last_valid_position_(0), sync_point_count_(0), data_offset_(0), fetch_batch_size_(64)
 {
 }
 
@@ -23,6 +29,7 @@ bool sync_file::load(const std::string& file_name, const std::string& data_file_
 {
 	file_.load(file_name);
 	position_ = 0;
+	fetched_data_.clear();
 
 	if (file_.eof() || !file_.is_open()) {
 		return false;
@@ -338,7 +345,6 @@ sync_event sync_file::fetch_new_event()
 const sync_point& sync_file::next()
 {
 	std::uint16_t type;
-	std::uint32_t data_offset;
 	std::uint8_t padding;
 
 	if (eof()) {
@@ -357,7 +363,7 @@ const sync_point& sync_file::next()
 			  >> old_sp.ebp >> old_sp.esp
 			  >> old_sp.eip >> old_sp.eflags
 			  >> old_sp.cr0 >> old_sp.cr2 >> old_sp.cr3 >> old_sp.cr4
-			  >> data_offset >> old_sp.fpu_sw >> old_sp.fpu_cw >> old_sp.fpu_tags
+			  >> data_offset_ >> old_sp.fpu_sw >> old_sp.fpu_cw >> old_sp.fpu_tags
 			  >> old_sp.fault_error_code;
 
 			file_ >> padding;
@@ -372,7 +378,7 @@ const sync_point& sync_file::next()
 			  >> current_.r12 >> current_.r13 >> current_.r14 >> current_.r15
 			  >> current_.rip >> current_.rflags
 			  >> current_.cr0 >> current_.cr2 >> current_.cr3 >> current_.cr4
-			  >> data_offset >> current_.fpu_sw >> current_.fpu_cw >> current_.fpu_tags
+			  >> data_offset_ >> current_.fpu_sw >> current_.fpu_cw >> current_.fpu_tags
 			  >> current_.fault_error_code;
 
 			// We are reading 201 bytes from the file.
@@ -392,8 +398,17 @@ const sync_point& sync_file::next()
 
 		current_.data.clear();
 
-		if (data_offset && !data_file_.eof()) {
-			data_file_.seek(data_offset);
+		if (data_offset_ && data_fetcher_ && version_ > 0) {
+			auto fetched = fetched_data_.find(data_offset_);
+
+			if (fetched == fetched_data_.end()) {
+				fetch_data_batch();
+				fetched = fetched_data_.find(data_offset_);
+			}
+
+			current_.data = fetched->second;
+		} else if (data_offset_ && !data_file_.eof()) {
+			data_file_.seek(data_offset_);
 
 			while (true) {
 				std::uint32_t data_type;
@@ -406,7 +421,10 @@ const sync_point& sync_file::next()
 				if (d.type == sync_point_data_type::data_end)
 					break;
 
-				data_file_ >> d.offset >> d.data;
+				std::vector<std::uint8_t> bytes;
+				data_file_ >> d.offset >> bytes;
+
+				d.data = blob_pool_ ? blob_pool_->intern(std::move(bytes)) : shared_blob(std::move(bytes));
 
 				current_.data.push_back(d);
 			}
@@ -423,6 +441,36 @@ const sync_point& sync_file::next()
 	return current_;
 }
 
+void sync_file::fetch_data_batch()
+{
+	std::uint64_t next_record = file_.pos();
+	std::uint32_t field = version_ < 3 ? DATA_OFFSET_FIELD_V2 : DATA_OFFSET_FIELD_V3;
+
+	// The current record is at position_, which is not incremented yet.
+	std::vector<char> records(static_cast<std::size_t>(record_size_) * fetch_batch_size_);
+	file_.seek(HEADER_SIZE + record_size_ * position_);
+	file_.read_bulk(records.data(), records.size());
+	file_.seek(next_record);
+
+	// Records past the end of the file are zeroed, like their data offset.
+	std::vector<std::uint32_t> offsets{data_offset_};
+	std::unordered_set<std::uint32_t> seen{data_offset_};
+
+	for (std::size_t record = 1; record < fetch_batch_size_; ++record) {
+		std::uint32_t offset;
+		std::memcpy(&offset, records.data() + record * record_size_ + field, sizeof(offset));
+
+		if (offset && seen.insert(offset).second)
+			offsets.push_back(offset);
+	}
+
+	auto data = data_fetcher_->fetch(offsets, blob_pool_.get());
+
+	fetched_data_.clear();
+	for (std::size_t i = 0; i < offsets.size(); ++i)
+		fetched_data_.emplace(offsets[i], std::move(data[i]));
+}
+
 std::uint64_t sync_file::position() const
 {
 	return position_;
@@ -445,6 +493,12 @@ void sync_file::advance_to(std::uint64_t position)
 	}
 }
 
+void sync_file::seek_point(std::uint64_t position)
+{
+	seek(position);
+	current_event_ = sync_event();
+}
+
 void sync_file::seek(std::uint64_t position)
 {
 	if (!record_size_) {
@@ -455,6 +509,7 @@ void sync_file::seek(std::uint64_t position)
 	if (position == 0) {
 		last_valid_position_ = position;
 		current_ = sync_point();
+		data_offset_ = 0;
 		file_.seek(HEADER_SIZE);
 		position_ = 0;
 		return;
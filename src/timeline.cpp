@@ -0,0 +1,119 @@
+#include <timeline.h>
+
+namespace reven {
+namespace vmghost {
+
+timeline::timeline(sync_file& sync, const std::vector<hardware_file*>& hardware)
+  : sync_(sync), hardware_(hardware), indexes_(hardware.size(), nullptr), sync_ready_(false),
+    hardware_ready_(hardware.size(), false)
+{
+}
+
+void timeline::set_index(std::size_t source, const hardware_index* index)
+{
+	indexes_[source] = index;
+}
+
+std::uint64_t timeline::event_tsc(const sync_event& event)
+{
+	return event.is_first_event_context_unknown ? event.new_context.tsc : event.start_context.tsc;
+}
+
+const timeline_item& timeline::next()
+{
+	// The sources of the previous item are only moved now, so that it stays valid until then.
+	if (not sync_ready_) {
+		advance_sync();
+		sync_ready_ = true;
+	}
+
+	for (std::size_t i = 0; i < hardware_.size(); ++i) {
+		if (not hardware_ready_[i]) {
+			hardware_[i]->next();
+			hardware_ready_[i] = true;
+		}
+	}
+
+	current_ = timeline_item();
+
+	const sync_event& event = sync_.current_event();
+	if (event.is_valid) {
+		current_.type = timeline_item::kind::event;
+		current_.tsc = event_tsc(event);
+		current_.event = &event;
+	}
+
+	// Strictly lower TSCs only, for ties to go to the event and then to the first hardware files.
+	for (std::size_t i = 0; i < hardware_.size(); ++i) {
+		const hardware_access& access = hardware_[i]->current();
+
+		if (access.valid() && (not current_.valid() || access.tsc < current_.tsc)) {
+			current_.type = timeline_item::kind::access;
+			current_.tsc = access.tsc;
+			current_.source = i;
+			current_.event = nullptr;
+			current_.access = &access;
+		}
+	}
+
+	if (current_.is_event())
+		sync_ready_ = false;
+	else if (current_.is_access())
+		hardware_ready_[current_.source] = false;
+
+	return current_;
+}
+
+void timeline::seek_tsc(std::uint64_t tsc)
+{
+	current_ = timeline_item();
+
+	seek_sync(tsc);
+	sync_ready_ = true;
+
+	for (std::size_t i = 0; i < hardware_.size(); ++i) {
+		hardware_file& file = *hardware_[i];
+		const hardware_index* index = indexes_[i];
+
+		if (index != nullptr && not index->entries().empty() && file.version() == 0)
+			index->seek_tsc(file, tsc);
+		else
+			file.seek_tsc(tsc);
+
+		hardware_ready_[i] = true;
+	}
+}
+
+void timeline::advance_sync()
+{
+	sync_.next();
+	sync_.current_event();
+}
+
+void timeline::seek_sync(std::uint64_t tsc)
+{
+	// Sync points have a fixed size: binary search the first one whose TSC is greater or equal to tsc.
+	std::uint64_t first = 1;
+	std::uint64_t count = sync_.sync_point_count();
+
+	while (count > 0) {
+		std::uint64_t half = count / 2;
+
+		sync_.advance_to(first + half);
+		if (sync_.current().tsc < tsc) {
+			first += half + 1;
+			count -= half + 1;
+		} else {
+			count = half;
+		}
+	}
+
+	// Restart just before it, and skip the event it may end.
+	sync_.advance_to(first - 1);
+
+	do {
+		advance_sync();
+	} while (sync_.current_event().is_valid && event_tsc(sync_.current_event()) < tsc);
+}
+}
+} // namespace reven::vmghost